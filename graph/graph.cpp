@@ -1,23 +1,93 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "gtest/gtest.h"
 
-class IGraph
+int default_thread_count() {
+    const auto hardware_threads = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(hardware_threads, 1);
+}
+
+// Splits [0, count) into one contiguous chunk per thread and calls body(begin, end) for each chunk.
+// The calling thread takes the first chunk itself.
+void parallel_for(std::size_t count, int thread_count, const std::function<void (std::size_t, std::size_t)>& body) {
+    const std::size_t chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(std::max(thread_count, 1), count));
+    const std::size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    std::vector<std::thread> threads;
+    for (std::size_t begin = chunk_size; begin < count; begin += chunk_size) {
+        threads.emplace_back(body, begin, std::min(begin + chunk_size, count));
+    }
+
+    body(0, std::min(chunk_size, count));
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Every graph type is a template over the integer type used for vertex ids, so 16 bit ids can
+// keep a small graph cache resident and 64 bit ids can address billions of vertices. The
+// unprefixed names (IGraph, AdjacencyListGraph, ...) are the int versions.
+template <typename V>
+class IBasicGraph
 {
 public:
-    virtual ~IGraph() = default;
-    virtual void AddEdge(int from, int to, bool directed) = 0;
-    virtual void RemoveEdge(int from, int to, bool directed) = 0;
-    virtual std::vector<int> GetEdgesForVertex(int vertex) = 0;
-    virtual int GetVertexCount() const = 0;
+    typedef V VertexId;
+
+    virtual ~IBasicGraph() = default;
+    virtual void AddEdge(VertexId from, VertexId to, bool directed) = 0;
+    // Adds a whole batch of edges at once. With deduplicate set, the neighbours of every vertex
+    // that the batch touches end up sorted and without repeats.
+    virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>& edges, bool directed, bool deduplicate) = 0;
+    virtual void RemoveEdge(VertexId from, VertexId to, bool directed) = 0;
+    virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) = 0;
+    virtual VertexId GetVertexCount() const = 0;
 };
 
-class AdjacencyMatrixGraph : public IGraph
+typedef IBasicGraph<int> IGraph;
+
+// Marks "no vertex" in parent tables and the like: -1 for signed ids, the largest id otherwise.
+template <typename VertexId>
+VertexId null_vertex() {
+    return static_cast<VertexId>(-1);
+}
+
+template <typename V>
+class BasicAdjacencyMatrixGraph : public IBasicGraph<V>
 {
 public:
-    AdjacencyMatrixGraph(int number_of_vertices) {
-        for (int i = 0; i < number_of_vertices; i++) {
+    typedef V VertexId;
+
+    BasicAdjacencyMatrixGraph(VertexId number_of_vertices) {
+        for (VertexId i = 0; i < number_of_vertices; i++) {
             std::vector<int> row;
             row.resize(number_of_vertices, 0);
 
@@ -25,23 +95,47 @@ public:
         }
     }
 
-    virtual void AddEdge(int from, int to, bool directed) override {
+    virtual void AddEdge(VertexId from, VertexId to, bool directed) override {
         m_matrix[from][to] += 1;
         if (!directed) {
             AddEdge(to, from, true);
         }
     }
 
-    virtual void RemoveEdge(int from, int to, bool directed) override {
+    virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>& edges, bool directed, bool deduplicate) override {
+        std::vector<char> touched(m_matrix.size(), 0);
+        for (const auto& edge : edges) {
+            m_matrix[edge.first][edge.second] += 1;
+            touched[edge.first] = 1;
+            if (!directed) {
+                m_matrix[edge.second][edge.first] += 1;
+                touched[edge.second] = 1;
+            }
+        }
+
+        if (!deduplicate) {
+            return;
+        }
+
+        for (std::size_t i = 0; i < m_matrix.size(); i++) {
+            if (touched[i]) {
+                for (auto& count : m_matrix[i]) {
+                    count = std::min(count, 1);
+                }
+            }
+        }
+    }
+
+    virtual void RemoveEdge(VertexId from, VertexId to, bool directed) override {
         m_matrix[from][to] = std::max(m_matrix[from][to] - 1, 0);
         if (!directed) {
             m_matrix[to][from] = std::max(m_matrix[to][from] - 1, 0);
         }
     }
 
-    virtual std::vector<int> GetEdgesForVertex(int vertex) override {
-        std::vector<int> result;
-        for (int i = 0; i < m_matrix.size(); i++) {
+    virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) override {
+        std::vector<VertexId> result;
+        for (std::size_t i = 0; i < m_matrix.size(); i++) {
             for (int j = 0; j < m_matrix[vertex][i]; j++) {
                 result.push_back(i);
             }
@@ -50,7 +144,7 @@ public:
         return result;
     }
 
-    virtual int GetVertexCount() const override {
+    virtual VertexId GetVertexCount() const override {
         return m_matrix.size();
     }
 
@@ -59,32 +153,84 @@ private:
     std::vector<std::vector<int>> m_matrix;
 };
 
-class AdjacencyListGraph : public IGraph
+typedef BasicAdjacencyMatrixGraph<int> AdjacencyMatrixGraph;
+
+template <typename V>
+class BasicAdjacencyListGraph : public IBasicGraph<V>
 {
+public:
+    typedef V VertexId;
+
 private:
     class Edge {
     public:
-        Edge(int to) : m_to(to) {            
+        Edge(VertexId to) : m_to(to) {
         }
 
-        int m_to;
+        VertexId m_to;
     };
 public:
-    AdjacencyListGraph(int number_of_vertices) {
-        for (int i = 0; i < number_of_vertices; i++) {
+    BasicAdjacencyListGraph(VertexId number_of_vertices) {
+        for (VertexId i = 0; i < number_of_vertices; i++) {
             std::vector<Edge> list;
             m_lists.push_back(list);
         }
     }
 
-    virtual void AddEdge(int from, int to, bool directed) override {
+    virtual void AddEdge(VertexId from, VertexId to, bool directed) override {
         m_lists[from].push_back(Edge(to));
         if (!directed) {
             AddEdge(to, from, true);
         }
     }
 
-    virtual void RemoveEdge(int from, int to, bool directed) override {
+    virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>& edges, bool directed, bool deduplicate) override {
+        const std::size_t vertex_count = GetVertexCount();
+
+        // bucket the new neighbours by vertex first (a counting sort), so every list is
+        // reserved once instead of growing an edge at a time
+        std::vector<std::size_t> offsets(vertex_count + 1, 0);
+        for (const auto& edge : edges) {
+            offsets[edge.first + 1]++;
+            if (!directed) {
+                offsets[edge.second + 1]++;
+            }
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<VertexId> neighbours(offsets.back());
+        std::vector<std::size_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (const auto& edge : edges) {
+            neighbours[cursors[edge.first]++] = edge.second;
+            if (!directed) {
+                neighbours[cursors[edge.second]++] = edge.first;
+            }
+        }
+
+        const std::size_t min_edges_per_thread = 1 << 16;
+        const int thread_count = std::min<std::size_t>(default_thread_count(), offsets.back() / min_edges_per_thread);
+        parallel_for(vertex_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t vertex = begin; vertex < end; vertex++) {
+                if (offsets[vertex] == offsets[vertex + 1]) {
+                    continue;
+                }
+
+                auto& list = m_lists[vertex];
+                list.reserve(list.size() + offsets[vertex + 1] - offsets[vertex]);
+                for (std::size_t i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+                    list.push_back(Edge(neighbours[i]));
+                }
+
+                if (deduplicate) {
+                    std::sort(list.begin(), list.end(), [] (const Edge& a, const Edge& b) { return a.m_to < b.m_to; });
+                    auto last = std::unique(list.begin(), list.end(), [] (const Edge& a, const Edge& b) { return a.m_to == b.m_to; });
+                    list.erase(last, list.end());
+                }
+            }
+        });
+    }
+
+    virtual void RemoveEdge(VertexId from, VertexId to, bool directed) override {
         auto& list = m_lists[from];
         auto to_remove = std::find_if(list.begin(), list.end(), [to] (const Edge& e) { return e.m_to == to; } );
         if (to_remove != list.end()) {
@@ -96,8 +242,8 @@ public:
         }
     }
 
-    virtual std::vector<int> GetEdgesForVertex(int vertex) override {
-        std::vector<int> result;
+    virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) override {
+        std::vector<VertexId> result;
         for (const auto& v : m_lists[vertex]) {
             result.push_back(v.m_to);
         }
@@ -105,7 +251,7 @@ public:
         return result;
     }
 
-    virtual int GetVertexCount() const override {
+    virtual VertexId GetVertexCount() const override {
         return m_lists.size();
     }
 
@@ -114,79 +260,577 @@ private:
     std::vector<std::vector<Edge>> m_lists;
 };
 
-enum class VertexState
+typedef BasicAdjacencyListGraph<int> AdjacencyListGraph;
+
+// Graph that many threads can read while a writer keeps updating it, without the readers taking
+// any locks. Readers pin an immutable version with TakeSnapshot(). Every write copies only the
+// adjacency lists it changes (plus the chunk of the vertex table that points at them) and
+// publishes a new version; replaced versions are freed by epoch-based reclamation once no
+// reader that could still see them is left.
+template <typename V>
+class BasicSnapshotGraph : public IBasicGraph<V>
+{
+public:
+    typedef V VertexId;
+
+private:
+    typedef std::vector<VertexId> AdjacencyList;
+
+    static const int chunk_size = 256;
+    static const int reader_slot_count = 128;
+
+    class Chunk {
+    public:
+        Chunk() {
+            m_lists.fill(nullptr);
+        }
+
+        std::array<const AdjacencyList*, chunk_size> m_lists;
+    };
+
+    class Version {
+    public:
+        std::vector<const Chunk*> m_chunks;
+    };
+
+    // Everything a single write replaced, tagged with the epoch it was retired in.
+    class Retired {
+    public:
+        std::uint64_t m_epoch;
+        std::unique_ptr<const Version> m_version;
+        std::vector<std::unique_ptr<const Chunk>> m_chunks;
+        std::vector<std::unique_ptr<const AdjacencyList>> m_lists;
+    };
+
+    // Epoch a reader pinned, or 0 if the slot is free. Padded so readers don't share cache lines.
+    class ReaderSlot {
+    public:
+        std::atomic<std::uint64_t> m_epoch{0};
+        char m_padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+public:
+    class Snapshot : public IBasicGraph<V>
+    {
+    public:
+        Snapshot(const BasicSnapshotGraph* graph) : m_graph(graph), m_slot(graph->PinReader()) {
+            m_version = m_graph->m_current.load();
+        }
+
+        Snapshot(Snapshot&& other) : m_graph(other.m_graph), m_slot(other.m_slot), m_version(other.m_version) {
+            other.m_graph = nullptr;
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        virtual ~Snapshot() {
+            if (m_graph) {
+                m_graph->UnpinReader(m_slot);
+            }
+        }
+
+        virtual void AddEdge(VertexId, VertexId, bool) override {
+            throw std::logic_error("snapshots are read-only");
+        }
+
+        virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>&, bool, bool) override {
+            throw std::logic_error("snapshots are read-only");
+        }
+
+        virtual void RemoveEdge(VertexId, VertexId, bool) override {
+            throw std::logic_error("snapshots are read-only");
+        }
+
+        virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) override {
+            return Neighbours(vertex);
+        }
+
+        virtual VertexId GetVertexCount() const override {
+            return m_graph->m_vertex_count;
+        }
+
+        // Neighbours without the copy that GetEdgesForVertex() makes. Valid while the snapshot lives.
+        const std::vector<VertexId>& Neighbours(VertexId vertex) const {
+            return BasicSnapshotGraph::Lookup(m_version, vertex);
+        }
+
+    private:
+
+        const BasicSnapshotGraph* m_graph;
+        int m_slot;
+        const Version* m_version;
+    };
+
+    BasicSnapshotGraph(VertexId number_of_vertices) : m_vertex_count(number_of_vertices) {
+        auto version = new Version();
+        const std::size_t chunk_count = (static_cast<std::size_t>(number_of_vertices) + chunk_size - 1) / chunk_size;
+        for (std::size_t i = 0; i < chunk_count; i++) {
+            version->m_chunks.push_back(new Chunk());
+        }
+        m_current.store(version);
+    }
+
+    BasicSnapshotGraph(const BasicSnapshotGraph&) = delete;
+    BasicSnapshotGraph& operator=(const BasicSnapshotGraph&) = delete;
+
+    virtual ~BasicSnapshotGraph() {
+        const Version* version = m_current.load();
+        for (auto chunk : version->m_chunks) {
+            for (auto list : chunk->m_lists) {
+                delete list;
+            }
+            delete chunk;
+        }
+        delete version;
+    }
+
+    Snapshot TakeSnapshot() const {
+        return Snapshot(this);
+    }
+
+    virtual void AddEdge(VertexId from, VertexId to, bool directed) override {
+        Publish(Touched(from, to, directed), [=] (VertexId vertex, AdjacencyList& list) {
+            if (vertex == from) {
+                list.push_back(to);
+            }
+            if (!directed && vertex == to) {
+                list.push_back(from);
+            }
+        });
+    }
+
+    virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>& edges, bool directed, bool deduplicate) override {
+        std::vector<std::size_t> offsets(static_cast<std::size_t>(m_vertex_count) + 1, 0);
+        for (const auto& edge : edges) {
+            offsets[edge.first + 1]++;
+            if (!directed) {
+                offsets[edge.second + 1]++;
+            }
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<VertexId> neighbours(offsets.back());
+        std::vector<std::size_t> cursors(offsets.begin(), offsets.end() - 1);
+        std::vector<VertexId> touched;
+        for (const auto& edge : edges) {
+            neighbours[cursors[edge.first]++] = edge.second;
+            touched.push_back(edge.first);
+            if (!directed) {
+                neighbours[cursors[edge.second]++] = edge.first;
+                touched.push_back(edge.second);
+            }
+        }
+
+        // the whole batch becomes visible to readers at once
+        Publish(touched, [&] (VertexId vertex, AdjacencyList& list) {
+            list.insert(list.end(), neighbours.begin() + offsets[vertex], neighbours.begin() + offsets[vertex + 1]);
+            if (deduplicate) {
+                std::sort(list.begin(), list.end());
+                list.erase(std::unique(list.begin(), list.end()), list.end());
+            }
+        });
+    }
+
+    virtual void RemoveEdge(VertexId from, VertexId to, bool directed) override {
+        auto remove = [] (AdjacencyList& list, VertexId neighbour) {
+            auto to_remove = std::find(list.begin(), list.end(), neighbour);
+            if (to_remove != list.end()) {
+                list.erase(to_remove);
+            }
+        };
+
+        Publish(Touched(from, to, directed), [=] (VertexId vertex, AdjacencyList& list) {
+            if (vertex == from) {
+                remove(list, to);
+            }
+            if (!directed && vertex == to) {
+                remove(list, from);
+            }
+        });
+    }
+
+    virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) override {
+        return TakeSnapshot().Neighbours(vertex);
+    }
+
+    virtual VertexId GetVertexCount() const override {
+        return m_vertex_count;
+    }
+
+private:
+
+    static const AdjacencyList& Lookup(const Version* version, VertexId vertex) {
+        static const AdjacencyList empty;
+
+        const auto list = version->m_chunks[vertex / chunk_size]->m_lists[vertex % chunk_size];
+        return list ? *list : empty;
+    }
+
+    int PinReader() const {
+        const auto start = std::hash<std::thread::id>()(std::this_thread::get_id());
+        while (true) {
+            for (int i = 0; i < reader_slot_count; i++) {
+                auto& slot = m_readers[(start + i) % reader_slot_count];
+                std::uint64_t expected = 0;
+                if (slot.m_epoch.compare_exchange_strong(expected, m_epoch.load())) {
+                    return (start + i) % reader_slot_count;
+                }
+            }
+
+            // more concurrent readers than slots, wait for one of them to finish
+            std::this_thread::yield();
+        }
+    }
+
+    void UnpinReader(int slot) const {
+        m_readers[slot].m_epoch.store(0);
+    }
+
+    // The vertices whose lists a single edge write changes; a directed edge leaves the target's alone.
+    static std::vector<VertexId> Touched(VertexId from, VertexId to, bool directed) {
+        if (directed) {
+            return { from };
+        }
+        return { from, to };
+    }
+
+    // Copies the adjacency list of each vertex in `vertices`, lets `change` edit the copies and
+    // publishes them all as one new version.
+    void Publish(std::vector<VertexId> vertices, const std::function<void (VertexId, AdjacencyList&)>& change) {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+
+        std::sort(vertices.begin(), vertices.end());
+        vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+        const Version* old_version = m_current.load();
+        auto version = new Version(*old_version);
+        auto retired = std::unique_ptr<Retired>(new Retired());
+
+        for (auto vertex : vertices) {
+            const std::size_t chunk_index = vertex / chunk_size;
+            const Chunk* old_chunk = old_version->m_chunks[chunk_index];
+            if (version->m_chunks[chunk_index] == old_chunk) {
+                version->m_chunks[chunk_index] = new Chunk(*old_chunk);
+                retired->m_chunks.emplace_back(old_chunk);
+            }
+
+            auto chunk = const_cast<Chunk*>(version->m_chunks[chunk_index]);
+            const AdjacencyList* old_list = chunk->m_lists[vertex % chunk_size];
+            auto list = old_list ? new AdjacencyList(*old_list) : new AdjacencyList();
+            change(vertex, *list);
+
+            chunk->m_lists[vertex % chunk_size] = list;
+            if (old_list) {
+                retired->m_lists.emplace_back(old_list);
+            }
+        }
+
+        m_current.store(version);
+        retired->m_version.reset(old_version);
+        retired->m_epoch = m_epoch.fetch_add(1);
+        m_retired.push_back(std::move(retired));
+
+        Reclaim();
+    }
+
+    // Frees everything retired before the oldest epoch that a reader still has pinned. A reader
+    // that pinned a later epoch started after the retired objects were unlinked.
+    void Reclaim() {
+        std::uint64_t oldest_pinned = std::numeric_limits<std::uint64_t>::max();
+        for (const auto& slot : m_readers) {
+            const auto epoch = slot.m_epoch.load();
+            if (epoch != 0) {
+                oldest_pinned = std::min(oldest_pinned, epoch);
+            }
+        }
+
+        m_retired.erase(
+            std::remove_if(m_retired.begin(), m_retired.end(), [=] (const std::unique_ptr<Retired>& r) {
+                return r->m_epoch < oldest_pinned;
+            }),
+            m_retired.end()
+        );
+    }
+
+    const VertexId m_vertex_count;
+    std::atomic<const Version*> m_current;
+    mutable std::atomic<std::uint64_t> m_epoch{1};
+    mutable std::array<ReaderSlot, reader_slot_count> m_readers;
+    std::mutex m_writer_mutex;
+    std::vector<std::unique_ptr<Retired>> m_retired;
+};
+
+typedef BasicSnapshotGraph<int> SnapshotGraph;
+
+enum class VertexState : unsigned char
 {
     Undiscovered,
     Discovered,
     Processed
 };
 
+// Vertex states and parents for bfs() and dfs() that can be reused from one traversal to the next.
+// Each vertex stores the epoch it was last touched in rather than its state: base + 1 means
+// discovered, base + 2 processed and anything older undiscovered. Clear() just moves the base on, so
+// many small traversals over a large graph don't pay O(V) each to reset their tables.
+template <typename V>
+class BasicTraversalWorkspace
+{
+public:
+    typedef V VertexId;
+
+    BasicTraversalWorkspace(std::size_t vertex_count = 0) :
+        m_stamps(vertex_count, 0),
+        m_parents(vertex_count, null_vertex<VertexId>()),
+        m_base(0) {
+    }
+
+    // Makes every vertex undiscovered again, growing the tables if the graph has grown.
+    void Clear(std::size_t vertex_count) {
+        if (m_stamps.size() < vertex_count) {
+            m_stamps.resize(vertex_count, 0);
+            m_parents.resize(vertex_count, null_vertex<VertexId>());
+        }
+
+        if (m_base >= std::numeric_limits<std::uint32_t>::max() - 4) {
+            // the epochs have wrapped round; pay for one real reset
+            std::fill(m_stamps.begin(), m_stamps.end(), 0);
+            m_base = 0;
+        } else {
+            m_base += 2;
+        }
+        m_queue.clear();
+    }
+
+    VertexState GetState(VertexId vertex) const {
+        const std::uint32_t stamp = m_stamps[vertex];
+        if (stamp <= m_base) {
+            return VertexState::Undiscovered;
+        }
+        return stamp == m_base + 1 ? VertexState::Discovered : VertexState::Processed;
+    }
+
+    void SetState(VertexId vertex, VertexState state) {
+        m_stamps[vertex] = m_base + static_cast<std::uint32_t>(state);
+    }
+
+    // Parents left over from earlier traversals read as null.
+    VertexId GetParent(VertexId vertex) const {
+        return GetState(vertex) == VertexState::Undiscovered ? null_vertex<VertexId>() : m_parents[vertex];
+    }
+
+    void SetParent(VertexId vertex, VertexId parent) {
+        m_parents[vertex] = parent;
+    }
+
+    std::size_t GetMemoryUsage() const {
+        return m_stamps.capacity() * sizeof(std::uint32_t) + m_parents.capacity() * sizeof(VertexId) +
+            m_queue.capacity() * sizeof(VertexId);
+    }
+
+    // scratch queue for bfs(), kept so that its capacity is reused
+    std::vector<VertexId> m_queue;
+
+private:
+
+    std::vector<std::uint32_t> m_stamps;
+    std::vector<VertexId> m_parents;
+    std::uint32_t m_base;
+};
+
+typedef BasicTraversalWorkspace<int> TraversalWorkspace;
+
+// Observer policy for the traversals. This one is the default and does nothing, so an
+// uninstrumented traversal compiles to the same code as before.
+class NoTraversalStats
+{
+public:
+    static const bool enabled = false;
+
+    void OnPhaseBegin(const char*, std::size_t) {}
+    void OnPhaseEnd() {}
+    void OnEdgeExamined() {}
+    void OnVertexDiscovered() {}
+    void OnAuxiliaryAllocated(std::size_t) {}
+    void OnAuxiliaryFreed(std::size_t) {}
+};
+
+// Records what a traversal did. A phase is one BFS level, or one whole DFS, and its frontier size
+// is the number of vertices it started with.
+class TraversalStats
+{
+public:
+    class Phase {
+    public:
+        const char* m_name;
+        std::size_t m_frontier_size;
+        std::chrono::nanoseconds m_duration;
+    };
+
+    static const bool enabled = true;
+
+    void OnPhaseBegin(const char* name, std::size_t frontier_size) {
+        m_phases.push_back(Phase{ name, frontier_size, std::chrono::nanoseconds(0) });
+        m_phase_start = std::chrono::steady_clock::now();
+    }
+
+    void OnPhaseEnd() {
+        m_phases.back().m_duration = std::chrono::steady_clock::now() - m_phase_start;
+    }
+
+    void OnEdgeExamined() {
+        m_edges_examined++;
+    }
+
+    void OnVertexDiscovered() {
+        m_vertices_discovered++;
+    }
+
+    void OnAuxiliaryAllocated(std::size_t bytes) {
+        m_auxiliary_bytes += bytes;
+        m_peak_auxiliary_bytes = std::max(m_peak_auxiliary_bytes, m_auxiliary_bytes);
+    }
+
+    void OnAuxiliaryFreed(std::size_t bytes) {
+        m_auxiliary_bytes -= bytes;
+    }
+
+    std::size_t m_edges_examined = 0;
+    std::size_t m_vertices_discovered = 0;
+    std::size_t m_auxiliary_bytes = 0;
+    std::size_t m_peak_auxiliary_bytes = 0;
+    std::vector<Phase> m_phases;
+
+private:
+
+    std::chrono::steady_clock::time_point m_phase_start;
+};
+
+// Breadth-first traversal using the tables in workspace. Vertices the workspace has already seen
+// are skipped, which lets a caller walk several components without clearing in between; call
+// workspace.Clear() first for an independent traversal.
+template <typename Graph, typename Stats>
 void bfs(
-    IGraph* graph,
-    const std::function<void (int, int)>& process_edge,
-    const std::function<void (int)>& process_vertex,
-    int start_vertex = 0
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    typename Graph::VertexId start_vertex,
+    BasicTraversalWorkspace<typename Graph::VertexId>& workspace,
+    Stats& stats
 ) {
-    // initialise the tables of processed and unprocessed vertices
-    const auto vertex_count = graph->GetVertexCount();
-    if (vertex_count <= 0) {
+    if (graph->GetVertexCount() <= 0 || workspace.GetState(start_vertex) != VertexState::Undiscovered) {
         return;
     }
 
-    std::vector<VertexState> state(vertex_count, VertexState::Undiscovered);
-    std::vector<int> parents(vertex_count, -1);
+    auto& to_process = workspace.m_queue;
+    to_process.clear();
+    std::size_t head = 0;
+    to_process.push_back(start_vertex);
+    workspace.SetState(start_vertex, VertexState::Discovered);
+    stats.OnVertexDiscovered();
+    stats.OnAuxiliaryAllocated(sizeof(start_vertex));
 
-    std::queue<int> to_process;
-    to_process.push(start_vertex);
-    state[start_vertex] = VertexState::Discovered;
+    // levels are only tracked when somebody is watching
+    std::size_t level = 0;
+    std::size_t level_remaining = 0;
 
-    while (!to_process.empty()) {
-        const auto vertex = to_process.front();
-        to_process.pop();
-        state[vertex] = VertexState::Processed;
+    while (head < to_process.size()) {
+        if (Stats::enabled && level_remaining == 0) {
+            if (level++ > 0) {
+                stats.OnPhaseEnd();
+            }
+            level_remaining = to_process.size() - head;
+            stats.OnPhaseBegin("bfs level", level_remaining);
+        }
+
+        const auto vertex = to_process[head++];
+        level_remaining--;
+        stats.OnAuxiliaryFreed(sizeof(vertex));
+        workspace.SetState(vertex, VertexState::Processed);
         process_vertex(vertex);
 
         const auto edges = graph->GetEdgesForVertex(vertex);
         for (auto edge : edges) {
-            if (state[edge] != VertexState::Processed) {
+            stats.OnEdgeExamined();
+            const VertexState state = workspace.GetState(edge);
+            if (state != VertexState::Processed) {
                 process_edge(vertex, edge);
             }
-            if (state[edge] == VertexState::Undiscovered) {
-                state[edge] = VertexState::Discovered;
-                to_process.push(edge);
-                parents[edge] = vertex;
+            if (state == VertexState::Undiscovered) {
+                workspace.SetState(edge, VertexState::Discovered);
+                workspace.SetParent(edge, vertex);
+                to_process.push_back(edge);
+                stats.OnVertexDiscovered();
+                stats.OnAuxiliaryAllocated(sizeof(edge));
             }
         }
     }
+
+    if (Stats::enabled) {
+        stats.OnPhaseEnd();
+    }
+}
+
+template <typename Graph, typename Stats>
+void bfs(
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    typename Graph::VertexId start_vertex,
+    Stats& stats
+) {
+    BasicTraversalWorkspace<typename Graph::VertexId> workspace(graph->GetVertexCount());
+    const std::size_t table_bytes = workspace.GetMemoryUsage();
+    stats.OnAuxiliaryAllocated(table_bytes);
+    bfs(graph, process_edge, process_vertex, start_vertex, workspace, stats);
+    stats.OnAuxiliaryFreed(table_bytes);
+}
+
+template <typename Graph>
+void bfs(
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    typename Graph::VertexId start_vertex = 0
+) {
+    NoTraversalStats stats;
+    bfs(graph, process_edge, process_vertex, start_vertex, stats);
 }
 
+template <typename Graph, typename Stats>
 void dfs_internal(
-    IGraph* graph,
-    std::vector<VertexState>& vertex_states,
-    std::vector<int>& parents,
-    int start_vertex,
-    const std::function<void (int)>& process_vertex,
-    const std::function<void (int, int)>& process_edge
+    Graph* graph,
+    BasicTraversalWorkspace<typename Graph::VertexId>& workspace,
+    typename Graph::VertexId start_vertex,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    Stats& stats
 ) {
-    if (vertex_states[start_vertex] == VertexState::Processed) {
+    if (workspace.GetState(start_vertex) == VertexState::Processed) {
         return;
     }
 
-    vertex_states[start_vertex] = VertexState::Discovered;
+    workspace.SetState(start_vertex, VertexState::Discovered);
+    stats.OnVertexDiscovered();
 
     auto edges = graph->GetEdgesForVertex(start_vertex);
     std::sort(edges.begin(), edges.end());
 
+    // every level of recursion keeps its own copy of the neighbours alive
+    stats.OnAuxiliaryAllocated(edges.size() * sizeof(edges[0]));
+
     for (auto edge : edges) {
-        if (parents[edge] == start_vertex) {
+        stats.OnEdgeExamined();
+        if (workspace.GetParent(edge) == start_vertex) {
             continue;
         }
 
-        switch (vertex_states[edge]) {
+        switch (workspace.GetState(edge)) {
         case VertexState::Undiscovered:
-            parents[start_vertex] = edge;
+            workspace.SetParent(start_vertex, edge);
             process_edge(start_vertex, edge);
-            dfs_internal(graph, vertex_states, parents, edge, process_vertex, process_edge);
+            dfs_internal(graph, workspace, edge, process_vertex, process_edge, stats);
             break;
         case VertexState::Discovered:
             process_edge(start_vertex, edge);
@@ -197,127 +841,3470 @@ void dfs_internal(
         }
     }
 
+    stats.OnAuxiliaryFreed(edges.size() * sizeof(edges[0]));
+
     process_vertex(start_vertex);
-    vertex_states[start_vertex] = VertexState::Processed;
+    workspace.SetState(start_vertex, VertexState::Processed);
 }
 
+// Depth-first traversal using the tables in workspace; like bfs(), it skips whatever the
+// workspace has already seen.
+template <typename Graph, typename Stats>
 void dfs(
-    IGraph* graph,
-    const std::function<void (int)>& process_vertex,
-    const std::function<void (int, int)>& process_edge,
-    int start_vertex = 0
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    typename Graph::VertexId start_vertex,
+    BasicTraversalWorkspace<typename Graph::VertexId>& workspace,
+    Stats& stats
 ) {
-    std::vector<int> parents(graph->GetVertexCount(), -1);
-    std::vector<VertexState> vertex_states(graph->GetVertexCount(), VertexState::Undiscovered);
-    dfs_internal(graph, vertex_states, parents, start_vertex, process_vertex, process_edge);
+    stats.OnPhaseBegin("dfs", 1);
+    dfs_internal(graph, workspace, start_vertex, process_vertex, process_edge, stats);
+    stats.OnPhaseEnd();
 }
 
-bool is_bipartite(IGraph* g) {
-    std::unordered_set<int> to_process;
-    for (auto i = 0; i < g->GetVertexCount(); i++) {
-        to_process.insert(i);
-    }
+template <typename Graph, typename Stats>
+void dfs(
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    typename Graph::VertexId start_vertex,
+    Stats& stats
+) {
+    BasicTraversalWorkspace<typename Graph::VertexId> workspace(graph->GetVertexCount());
+    const std::size_t table_bytes = workspace.GetMemoryUsage();
+    stats.OnAuxiliaryAllocated(table_bytes);
+    dfs(graph, process_vertex, process_edge, start_vertex, workspace, stats);
+    stats.OnAuxiliaryFreed(table_bytes);
+}
 
-    enum class VertexColor {
-        Uncoloured,
-        White,
-        Black
-    };
-    auto complement = [] (VertexColor c) {
-        switch (c) {
-        case VertexColor::White:
-            return VertexColor::Black;
-        case VertexColor::Black:
-            return VertexColor::White;
-        default:
-            return VertexColor::Uncoloured;
-        }
-    };
+template <typename Graph>
+void dfs(
+    Graph* graph,
+    const std::function<void (typename Graph::VertexId)>& process_vertex,
+    const std::function<void (typename Graph::VertexId, typename Graph::VertexId)>& process_edge,
+    typename Graph::VertexId start_vertex = 0
+) {
+    NoTraversalStats stats;
+    dfs(graph, process_vertex, process_edge, start_vertex, stats);
+}
 
-    std::vector<VertexColor> colours(g->GetVertexCount(), VertexColor::Uncoloured);
+// One vertex produced by a traversal cursor, with the tree edge (m_parent, m_vertex) it was
+// reached through. The start vertex has no parent.
+template <typename V>
+class BasicTraversalStep
+{
+public:
+    typedef V VertexId;
 
-    bool bipartite = true;
-    while (!to_process.empty()) {
-        colours[*(to_process.begin())] = VertexColor::White;
+    VertexId m_vertex;
+    VertexId m_parent;
+    std::size_t m_depth;
+};
 
-        auto process_vertex = [&] (int vertex) {
-            to_process.erase(vertex);
-        };
+// Input iterator over a cursor so that it can be used in a range-based for loop. Advancing the
+// iterator pulls the next step from the cursor.
+template <typename Cursor>
+class TraversalIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef typename Cursor::Step value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
 
-        auto process_edge = [&] (int start, int end) {
-            if (colours[start] == colours[end]) {
-                bipartite = false;
-                return;
-            }
+    TraversalIterator() : m_cursor(nullptr) {
+    }
 
-            colours[end] = complement(colours[start]);
-        };
-        bfs(g, process_edge, process_vertex, *(to_process.begin()));
+    explicit TraversalIterator(Cursor* cursor) : m_cursor(cursor) {
+        ++(*this);
     }
 
+    reference operator*() const {
+        return m_step;
+    }
+
+    pointer operator->() const {
+        return &m_step;
+    }
+
+    TraversalIterator& operator++() {
+        if (!m_cursor->Next(m_step)) {
+            m_cursor = nullptr;
+        }
+        return *this;
+    }
+
+    bool operator==(const TraversalIterator& other) const {
+        return m_cursor == other.m_cursor;
+    }
+
+    bool operator!=(const TraversalIterator& other) const {
+        return m_cursor != other.m_cursor;
+    }
+
+private:
+
+    Cursor* m_cursor;
+    value_type m_step;
+};
+
+// Pull-based breadth-first traversal. Each call to Next() hands out one vertex and leaves queueing
+// its neighbours to the following call, so a caller that stops early never pays for the adjacency
+// list of the last vertex it saw, let alone the rest of the graph. Several
+// cursors can walk the same graph side by side, and Reset() starts a new traversal without
+// reallocating.
+template <typename Graph>
+class BfsCursor
+{
+public:
+    typedef typename Graph::VertexId VertexId;
+    typedef BasicTraversalStep<VertexId> Step;
+
+    BfsCursor(Graph* graph, VertexId start_vertex = 0) :
+        m_graph(graph),
+        m_parents(graph->GetVertexCount(), null_vertex<VertexId>()),
+        m_depths(graph->GetVertexCount(), 0),
+        m_discovered(graph->GetVertexCount(), false),
+        m_head(0),
+        m_expanded(0) {
+        Reset(start_vertex);
+    }
+
+    // Stores the next vertex in step; returns false once every reachable vertex has been visited.
+    bool Next(Step& step) {
+        if (m_expanded < m_head) {
+            const VertexId previous = m_queue[m_expanded++];
+            for (auto edge : m_graph->GetEdgesForVertex(previous)) {
+                if (!m_discovered[edge]) {
+                    m_discovered[edge] = true;
+                    m_parents[edge] = previous;
+                    m_depths[edge] = m_depths[previous] + 1;
+                    m_queue.push_back(edge);
+                }
+            }
+        }
+        if (m_head == m_queue.size()) {
+            return false;
+        }
+
+        const VertexId vertex = m_queue[m_head++];
+        step.m_vertex = vertex;
+        step.m_parent = m_parents[vertex];
+        step.m_depth = m_depths[vertex];
+        return true;
+    }
+
+    // Starts again from start_vertex. Only the vertices the last traversal reached are cleared.
+    void Reset(VertexId start_vertex) {
+        for (auto vertex : m_queue) {
+            m_discovered[vertex] = false;
+            m_parents[vertex] = null_vertex<VertexId>();
+            m_depths[vertex] = 0;
+        }
+        m_queue.clear();
+        m_head = 0;
+        m_expanded = 0;
+
+        m_discovered[start_vertex] = true;
+        m_queue.push_back(start_vertex);
+    }
+
+    TraversalIterator<BfsCursor> begin() {
+        return TraversalIterator<BfsCursor>(this);
+    }
+
+    TraversalIterator<BfsCursor> end() {
+        return TraversalIterator<BfsCursor>();
+    }
+
+private:
+
+    Graph* m_graph;
+    std::vector<VertexId> m_parents;
+    std::vector<std::size_t> m_depths;
+    std::vector<bool> m_discovered;
+    // every vertex discovered so far, in order; the ones before m_head have been handed out and
+    // the ones before m_expanded have had their neighbours queued
+    std::vector<VertexId> m_queue;
+    std::size_t m_head;
+    std::size_t m_expanded;
+};
+
+// Pull-based depth-first traversal, handing out vertices in the same preorder as dfs() (lowest
+// neighbour first). Uses an explicit stack, so deep graphs don't exhaust the call stack.
+template <typename Graph>
+class DfsCursor
+{
+public:
+    typedef typename Graph::VertexId VertexId;
+    typedef BasicTraversalStep<VertexId> Step;
+
+    DfsCursor(Graph* graph, VertexId start_vertex = 0) :
+        m_graph(graph),
+        m_visited(graph->GetVertexCount(), false) {
+        Reset(start_vertex);
+    }
+
+    // Stores the next vertex in step; returns false once every reachable vertex has been visited.
+    bool Next(Step& step) {
+        while (!m_stack.empty()) {
+            const Step candidate = m_stack.back();
+            m_stack.pop_back();
+            if (m_visited[candidate.m_vertex]) {
+                continue;
+            }
+
+            m_visited[candidate.m_vertex] = true;
+            m_order.push_back(candidate.m_vertex);
+
+            // pushed in reverse so that the lowest neighbour comes off the stack first
+            auto edges = m_graph->GetEdgesForVertex(candidate.m_vertex);
+            std::sort(edges.begin(), edges.end());
+            for (auto edge = edges.rbegin(); edge != edges.rend(); edge++) {
+                if (!m_visited[*edge]) {
+                    m_stack.push_back(Step { *edge, candidate.m_vertex, candidate.m_depth + 1 });
+                }
+            }
+
+            step = candidate;
+            return true;
+        }
+        return false;
+    }
+
+    // Starts again from start_vertex. Only the vertices the last traversal reached are cleared.
+    void Reset(VertexId start_vertex) {
+        for (auto vertex : m_order) {
+            m_visited[vertex] = false;
+        }
+        m_order.clear();
+        m_stack.clear();
+
+        m_stack.push_back(Step { start_vertex, null_vertex<VertexId>(), 0 });
+    }
+
+    TraversalIterator<DfsCursor> begin() {
+        return TraversalIterator<DfsCursor>(this);
+    }
+
+    TraversalIterator<DfsCursor> end() {
+        return TraversalIterator<DfsCursor>();
+    }
+
+private:
+
+    Graph* m_graph;
+    std::vector<bool> m_visited;
+    std::vector<VertexId> m_order;
+    std::vector<Step> m_stack;
+};
+
+template <typename Graph, typename Stats>
+bool is_bipartite(Graph* g, Stats& stats) {
+    typedef typename Graph::VertexId VertexId;
+
+    enum class VertexColor {
+        Uncoloured,
+        White,
+        Black
+    };
+    auto complement = [] (VertexColor c) {
+        switch (c) {
+        case VertexColor::White:
+            return VertexColor::Black;
+        case VertexColor::Black:
+            return VertexColor::White;
+        default:
+            return VertexColor::Uncoloured;
+        }
+    };
+
+    std::vector<VertexColor> colours(g->GetVertexCount(), VertexColor::Uncoloured);
+
+    // one workspace for every component: a vertex seen by an earlier bfs() is never a new start
+    BasicTraversalWorkspace<VertexId> workspace(g->GetVertexCount());
+    const std::size_t table_bytes = workspace.GetMemoryUsage() + colours.size() * sizeof(VertexColor);
+    stats.OnAuxiliaryAllocated(table_bytes);
+
+    bool bipartite = true;
+    auto process_edge = [&] (VertexId start, VertexId end) {
+        if (colours[start] == colours[end]) {
+            bipartite = false;
+            return;
+        }
+
+        colours[end] = complement(colours[start]);
+    };
+
+    for (VertexId start = 0; start < g->GetVertexCount(); start++) {
+        if (workspace.GetState(start) != VertexState::Undiscovered) {
+            continue;
+        }
+
+        colours[start] = VertexColor::White;
+        bfs(g, process_edge, [] (VertexId) {}, start, workspace, stats);
+    }
+
+    stats.OnAuxiliaryFreed(table_bytes);
     return bipartite;
 }
 
-std::vector<std::vector<int>> connected_components(IGraph* graph) {
-    std::unordered_set<int> to_process;
-    for (auto i = 0; i < graph->GetVertexCount(); i++) {
-        to_process.insert(i);
+template <typename Graph>
+bool is_bipartite(Graph* g) {
+    NoTraversalStats stats;
+    return is_bipartite(g, stats);
+}
+
+template <typename Graph, typename Stats>
+std::vector<std::vector<typename Graph::VertexId>> connected_components(Graph* graph, Stats& stats) {
+    typedef typename Graph::VertexId VertexId;
+
+    // one workspace for every component: a vertex seen by an earlier bfs() is never a new start
+    BasicTraversalWorkspace<VertexId> workspace(graph->GetVertexCount());
+    const std::size_t table_bytes = workspace.GetMemoryUsage();
+    stats.OnAuxiliaryAllocated(table_bytes);
+
+    std::vector<std::vector<VertexId>> found_components;
+    for (VertexId start = 0; start < graph->GetVertexCount(); start++) {
+        if (workspace.GetState(start) != VertexState::Undiscovered) {
+            continue;
+        }
+
+        std::vector<VertexId> current_component;
+        auto process_vertex = [&] (VertexId vertex) {
+            current_component.push_back(vertex);
+        };
+        bfs(graph, [] (VertexId, VertexId) {}, process_vertex, start, workspace, stats);
+        found_components.push_back(current_component);
+    }
+
+    stats.OnAuxiliaryFreed(table_bytes);
+    return found_components;
+}
+
+template <typename Graph>
+std::vector<std::vector<typename Graph::VertexId>> connected_components(Graph* graph) {
+    NoTraversalStats stats;
+    return connected_components(graph, stats);
+}
+
+template <typename V>
+class BasicWeightedEdge
+{
+public:
+    typedef V VertexId;
+
+    BasicWeightedEdge(VertexId from, VertexId to, double weight) : m_from(from), m_to(to), m_weight(weight) {
+    }
+
+    VertexId m_from;
+    VertexId m_to;
+    double m_weight;
+};
+
+typedef BasicWeightedEdge<int> WeightedEdge;
+
+// Union-find that can be shared between threads. Roots are always linked below the smaller root,
+// so concurrent calls to Unite() can never create a cycle.
+template <typename VertexId>
+class ConcurrentUnionFind
+{
+public:
+    ConcurrentUnionFind(std::size_t number_of_vertices) : m_parents(number_of_vertices) {
+        for (std::size_t i = 0; i < number_of_vertices; i++) {
+            m_parents[i].store(i);
+        }
+    }
+
+    VertexId Find(VertexId vertex) {
+        while (true) {
+            VertexId parent = m_parents[vertex].load();
+            if (parent == vertex) {
+                return vertex;
+            }
+
+            const VertexId grandparent = m_parents[parent].load();
+            if (parent != grandparent) {
+                // path halving - if another thread got here first the path is already shorter
+                m_parents[vertex].compare_exchange_weak(parent, grandparent);
+            }
+            vertex = grandparent;
+        }
+    }
+
+    bool Unite(VertexId a, VertexId b) {
+        while (true) {
+            a = Find(a);
+            b = Find(b);
+            if (a == b) {
+                return false;
+            }
+
+            if (a < b) {
+                std::swap(a, b);
+            }
+
+            VertexId expected = a;
+            if (m_parents[a].compare_exchange_strong(expected, b)) {
+                return true;
+            }
+        }
+    }
+
+private:
+
+    std::vector<std::atomic<VertexId>> m_parents;
+};
+
+// Parallel Boruvka: every round each component picks its lightest outgoing edge, then all
+// components are contracted along the chosen edges. Ties are broken by edge index so every
+// component agrees on the order of the edges.
+template <typename VertexId>
+std::vector<BasicWeightedEdge<VertexId>> minimum_spanning_forest_boruvka(
+    std::size_t vertex_count,
+    const std::vector<BasicWeightedEdge<VertexId>>& edges,
+    int thread_count = default_thread_count()
+) {
+    const auto no_edge = std::numeric_limits<std::size_t>::max();
+    auto lighter = [&edges] (std::size_t a, std::size_t b) {
+        if (edges[a].m_weight != edges[b].m_weight) {
+            return edges[a].m_weight < edges[b].m_weight;
+        }
+        return a < b;
+    };
+
+    ConcurrentUnionFind<VertexId> components(vertex_count);
+    std::vector<std::atomic<std::size_t>> cheapest(vertex_count);
+    std::vector<std::size_t> remaining(edges.size());
+    std::iota(remaining.begin(), remaining.end(), 0);
+
+    std::vector<BasicWeightedEdge<VertexId>> forest;
+    std::mutex forest_mutex;
+
+    while (!remaining.empty()) {
+        parallel_for(vertex_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                cheapest[i].store(no_edge);
+            }
+        });
+
+        // offer every edge between two different components to both of them
+        std::vector<char> keep(remaining.size(), 0);
+        parallel_for(remaining.size(), thread_count, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                const std::size_t edge_index = remaining[i];
+                const VertexId from = components.Find(edges[edge_index].m_from);
+                const VertexId to = components.Find(edges[edge_index].m_to);
+                if (from == to) {
+                    continue;
+                }
+
+                keep[i] = 1;
+                for (auto root : { from, to }) {
+                    std::size_t current = cheapest[root].load();
+                    while ((current == no_edge || lighter(edge_index, current)) &&
+                           !cheapest[root].compare_exchange_weak(current, edge_index)) {
+                    }
+                }
+            }
+        });
+
+        // contract along the chosen edges - two components may have picked the same edge,
+        // in which case only the first Unite() succeeds
+        parallel_for(vertex_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            std::vector<BasicWeightedEdge<VertexId>> chosen;
+            for (std::size_t i = begin; i < end; i++) {
+                const std::size_t edge_index = cheapest[i].load();
+                if (edge_index != no_edge && components.Unite(edges[edge_index].m_from, edges[edge_index].m_to)) {
+                    chosen.push_back(edges[edge_index]);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(forest_mutex);
+            forest.insert(forest.end(), chosen.begin(), chosen.end());
+        });
+
+        std::vector<std::size_t> next_remaining;
+        for (std::size_t i = 0; i < remaining.size(); i++) {
+            if (keep[i]) {
+                next_remaining.push_back(remaining[i]);
+            }
+        }
+        remaining.swap(next_remaining);
+    }
+
+    return forest;
+}
+
+template <typename VertexId>
+bool lighter_edge(const BasicWeightedEdge<VertexId>& a, const BasicWeightedEdge<VertexId>& b) {
+    if (a.m_weight != b.m_weight) {
+        return a.m_weight < b.m_weight;
+    }
+    if (a.m_from != b.m_from) {
+        return a.m_from < b.m_from;
+    }
+    return a.m_to < b.m_to;
+}
+
+// Same scheme as partition() in quicksort.cpp, but with a median-of-three pivot so that edge
+// lists which are already (nearly) sorted by weight don't make filter-Kruskal quadratic.
+template <typename VertexId>
+std::size_t partition_edges(std::vector<BasicWeightedEdge<VertexId>>& edges, std::size_t start_index, std::size_t length) {
+    const std::size_t end_index = start_index + length - 1;
+    const std::size_t middle_index = start_index + length / 2;
+
+    if (lighter_edge(edges[middle_index], edges[start_index])) {
+        std::swap(edges[middle_index], edges[start_index]);
+    }
+    if (lighter_edge(edges[end_index], edges[start_index])) {
+        std::swap(edges[end_index], edges[start_index]);
+    }
+    if (lighter_edge(edges[end_index], edges[middle_index])) {
+        std::swap(edges[end_index], edges[middle_index]);
+    }
+    std::swap(edges[middle_index], edges[end_index]);
+
+    std::size_t partition_index = end_index;
+    std::size_t larger_index = start_index;
+
+    for (std::size_t i = start_index; i < end_index; i++) {
+        if (lighter_edge(edges[i], edges[partition_index])) {
+            std::swap(edges[i], edges[larger_index]);
+            larger_index++;
+        }
+    }
+
+    std::swap(edges[partition_index], edges[larger_index]);
+
+    return larger_index;
+}
+
+// Drops every edge in the range whose endpoints are already connected and returns the new length.
+template <typename VertexId>
+std::size_t filter_connected_edges(
+    std::vector<BasicWeightedEdge<VertexId>>& edges,
+    std::size_t start_index,
+    std::size_t length,
+    ConcurrentUnionFind<VertexId>& components,
+    int thread_count
+) {
+    const std::size_t min_edges_per_thread = 1 << 14;
+    thread_count = std::min<std::size_t>(thread_count, length / min_edges_per_thread);
+
+    std::vector<char> keep(length, 0);
+    parallel_for(length, thread_count, [&] (std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const auto& edge = edges[start_index + i];
+            keep[i] = components.Find(edge.m_from) != components.Find(edge.m_to);
+        }
+    });
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < length; i++) {
+        if (keep[i]) {
+            edges[start_index + kept] = edges[start_index + i];
+            kept++;
+        }
+    }
+
+    return kept;
+}
+
+template <typename VertexId>
+void filter_kruskal(
+    std::vector<BasicWeightedEdge<VertexId>>& edges,
+    std::size_t start_index,
+    std::size_t length,
+    ConcurrentUnionFind<VertexId>& components,
+    std::vector<BasicWeightedEdge<VertexId>>& forest,
+    int thread_count
+) {
+    const std::size_t base_case_length = 1024;
+
+    while (length > base_case_length) {
+        const std::size_t partition_index = partition_edges(edges, start_index, length);
+
+        filter_kruskal(edges, start_index, partition_index - start_index, components, forest, thread_count);
+        if (components.Unite(edges[partition_index].m_from, edges[partition_index].m_to)) {
+            forest.push_back(edges[partition_index]);
+        }
+
+        // heavy edges that the lighter ones already connected can never be chosen, so they
+        // are thrown away before anybody pays for sorting them
+        const std::size_t heavy_index = partition_index + 1;
+        const std::size_t heavy_length = start_index + length - heavy_index;
+        length = filter_connected_edges(edges, heavy_index, heavy_length, components, thread_count);
+        start_index = heavy_index;
+    }
+
+    std::sort(edges.begin() + start_index, edges.begin() + start_index + length, lighter_edge<VertexId>);
+    for (std::size_t i = start_index; i < start_index + length; i++) {
+        if (components.Unite(edges[i].m_from, edges[i].m_to)) {
+            forest.push_back(edges[i]);
+        }
+    }
+}
+
+template <typename VertexId>
+std::vector<BasicWeightedEdge<VertexId>> minimum_spanning_forest_filter_kruskal(
+    std::size_t vertex_count,
+    std::vector<BasicWeightedEdge<VertexId>> edges,
+    int thread_count = default_thread_count()
+) {
+    ConcurrentUnionFind<VertexId> components(vertex_count);
+    std::vector<BasicWeightedEdge<VertexId>> forest;
+    filter_kruskal(edges, 0, edges.size(), components, forest, thread_count);
+
+    return forest;
+}
+
+// Immutable compressed sparse row adjacency: the neighbours of row i are
+// m_targets[m_offsets[i]] up to (but not including) m_targets[m_offsets[i + 1]].
+template <typename V>
+class BasicCompressedSparseRows
+{
+public:
+    typedef V VertexId;
+
+    VertexId GetRowCount() const {
+        return m_offsets.size() - 1;
+    }
+
+    std::size_t GetDegree(VertexId row) const {
+        return m_offsets[row + 1] - m_offsets[row];
+    }
+
+    const VertexId* Begin(VertexId row) const {
+        return m_targets.data() + m_offsets[row];
+    }
+
+    const VertexId* End(VertexId row) const {
+        return m_targets.data() + m_offsets[row + 1];
+    }
+
+    std::vector<std::size_t> m_offsets{0};
+    std::vector<VertexId> m_targets;
+};
+
+typedef BasicCompressedSparseRows<int> CompressedSparseRows;
+
+template <typename Graph>
+BasicCompressedSparseRows<typename Graph::VertexId> to_compressed_sparse_rows(Graph* graph) {
+    typedef typename Graph::VertexId VertexId;
+
+    BasicCompressedSparseRows<VertexId> rows;
+    rows.m_offsets.reserve(static_cast<std::size_t>(graph->GetVertexCount()) + 1);
+    for (VertexId vertex = 0; vertex < graph->GetVertexCount(); vertex++) {
+        const auto edges = graph->GetEdgesForVertex(vertex);
+        rows.m_targets.insert(rows.m_targets.end(), edges.begin(), edges.end());
+        rows.m_offsets.push_back(rows.m_targets.size());
+    }
+
+    return rows;
+}
+
+// Read-only IBasicGraph view of compressed sparse rows, so that the algorithms here can run on
+// extracted subgraphs without copying them into a mutable graph first.
+template <typename V>
+class BasicCsrGraph : public IBasicGraph<V>
+{
+public:
+    typedef V VertexId;
+
+    BasicCsrGraph(BasicCompressedSparseRows<VertexId> rows) : m_rows(std::move(rows)) {
+    }
+
+    virtual void AddEdge(VertexId, VertexId, bool) override {
+        throw std::logic_error("compressed sparse row graphs are read-only");
+    }
+
+    virtual void AddEdges(const std::vector<std::pair<VertexId, VertexId>>&, bool, bool) override {
+        throw std::logic_error("compressed sparse row graphs are read-only");
+    }
+
+    virtual void RemoveEdge(VertexId, VertexId, bool) override {
+        throw std::logic_error("compressed sparse row graphs are read-only");
+    }
+
+    virtual std::vector<VertexId> GetEdgesForVertex(VertexId vertex) override {
+        return std::vector<VertexId>(m_rows.Begin(vertex), m_rows.End(vertex));
+    }
+
+    virtual VertexId GetVertexCount() const override {
+        return m_rows.GetRowCount();
+    }
+
+    const BasicCompressedSparseRows<VertexId>& GetRows() const {
+        return m_rows;
+    }
+
+private:
+
+    BasicCompressedSparseRows<VertexId> m_rows;
+};
+
+typedef BasicCsrGraph<int> CsrGraph;
+
+class Barrier
+{
+public:
+    Barrier(int thread_count) : m_thread_count(thread_count) {
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto generation = m_generation;
+        if (++m_waiting == m_thread_count) {
+            m_waiting = 0;
+            m_generation++;
+            m_condition.notify_all();
+        } else {
+            m_condition.wait(lock, [&] { return m_generation != generation; });
+        }
+    }
+
+private:
+
+    const int m_thread_count;
+    int m_waiting = 0;
+    int m_generation = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+// Carries messages between the workers of a partitioned computation. Exchange() is collective:
+// every worker calls it once per superstep with one (possibly empty) message for each worker and
+// gets back the messages all workers sent to it, indexed by sender.
+template <typename T>
+class IBasicMessageTransport
+{
+public:
+    typedef std::vector<T> Message;
+
+    virtual ~IBasicMessageTransport() = default;
+    virtual std::vector<Message> Exchange(int worker, std::vector<Message> outgoing) = 0;
+    virtual int GetWorkerCount() const = 0;
+};
+
+typedef IBasicMessageTransport<int> IMessageTransport;
+
+// Transport for workers that are threads of the same process.
+template <typename T>
+class BasicSharedMemoryTransport : public IBasicMessageTransport<T>
+{
+public:
+    typedef std::vector<T> Message;
+
+    BasicSharedMemoryTransport(int worker_count) :
+        m_mailboxes(worker_count, std::vector<Message>(worker_count)),
+        m_barrier(worker_count) {
+    }
+
+    virtual std::vector<Message> Exchange(int worker, std::vector<Message> outgoing) override {
+        for (std::size_t to = 0; to < outgoing.size(); to++) {
+            m_mailboxes[to][worker] = std::move(outgoing[to]);
+        }
+        m_barrier.Wait();
+
+        auto incoming = std::move(m_mailboxes[worker]);
+        m_mailboxes[worker].resize(incoming.size());
+
+        // nobody may post the next superstep's messages before everyone has collected these
+        m_barrier.Wait();
+        return incoming;
+    }
+
+    virtual int GetWorkerCount() const override {
+        return m_mailboxes.size();
+    }
+
+private:
+
+    std::vector<std::vector<Message>> m_mailboxes;
+    Barrier m_barrier;
+};
+
+typedef BasicSharedMemoryTransport<int> SharedMemoryTransport;
+
+// Transport over a mesh of Unix domain socket pairs. The sockets are created up front, so the
+// workers can equally be threads or processes forked after construction.
+template <typename T>
+class BasicUnixSocketTransport : public IBasicMessageTransport<T>
+{
+public:
+    typedef std::vector<T> Message;
+
+private:
+    class PeerTransfer {
+    public:
+        std::vector<char> m_frame;
+        std::size_t m_sent = 0;
+        std::uint64_t m_incoming_size = 0;
+        std::size_t m_header_received = 0;
+        std::size_t m_received = 0;
+        bool m_receive_done = false;
+    };
+
+public:
+    BasicUnixSocketTransport(int worker_count) : m_sockets(worker_count, std::vector<int>(worker_count, -1)) {
+        for (int i = 0; i < worker_count; i++) {
+            for (int j = i + 1; j < worker_count; j++) {
+                int fds[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                    throw std::system_error(errno, std::generic_category(), "socketpair");
+                }
+
+                m_sockets[i][j] = fds[0];
+                m_sockets[j][i] = fds[1];
+                for (auto fd : fds) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                }
+            }
+        }
+    }
+
+    BasicUnixSocketTransport(const BasicUnixSocketTransport&) = delete;
+    BasicUnixSocketTransport& operator=(const BasicUnixSocketTransport&) = delete;
+
+    virtual ~BasicUnixSocketTransport() {
+        for (const auto& row : m_sockets) {
+            for (auto fd : row) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    virtual std::vector<Message> Exchange(int worker, std::vector<Message> outgoing) override {
+        const int worker_count = GetWorkerCount();
+        std::vector<Message> incoming(worker_count);
+        incoming[worker] = std::move(outgoing[worker]);
+
+        // every frame is the 64 bit payload length followed by the payload
+        std::vector<PeerTransfer> transfers(worker_count);
+        for (int peer = 0; peer < worker_count; peer++) {
+            if (peer == worker) {
+                continue;
+            }
+
+            const std::uint64_t size = outgoing[peer].size();
+            auto& frame = transfers[peer].m_frame;
+            frame.resize(sizeof(size) + size * sizeof(T));
+            std::memcpy(frame.data(), &size, sizeof(size));
+            if (size != 0) {
+                std::memcpy(frame.data() + sizeof(size), outgoing[peer].data(), size * sizeof(T));
+            }
+        }
+
+        // sends and receives are interleaved with poll(), so two workers sending each other more
+        // than a socket buffer's worth can't deadlock
+        std::vector<pollfd> fds;
+        std::vector<int> peers;
+        while (true) {
+            fds.clear();
+            peers.clear();
+            for (int peer = 0; peer < worker_count; peer++) {
+                if (peer == worker) {
+                    continue;
+                }
+
+                const auto& transfer = transfers[peer];
+                short events = 0;
+                if (transfer.m_sent < transfer.m_frame.size()) {
+                    events |= POLLOUT;
+                }
+                if (!transfer.m_receive_done) {
+                    events |= POLLIN;
+                }
+                if (events) {
+                    fds.push_back(pollfd{ m_sockets[worker][peer], events, 0 });
+                    peers.push_back(peer);
+                }
+            }
+
+            if (fds.empty()) {
+                break;
+            }
+
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "poll");
+            }
+
+            for (std::size_t i = 0; i < fds.size(); i++) {
+                auto& transfer = transfers[peers[i]];
+                if (fds[i].revents & POLLOUT) {
+                    Send(fds[i].fd, transfer);
+                }
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    Receive(fds[i].fd, transfer, incoming[peers[i]]);
+                }
+            }
+        }
+
+        return incoming;
+    }
+
+    virtual int GetWorkerCount() const override {
+        return m_sockets.size();
+    }
+
+private:
+
+    static bool Interrupted(ssize_t result) {
+        if (result >= 0) {
+            return false;
+        }
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+        throw std::system_error(errno, std::generic_category(), "socket transfer");
+    }
+
+    static void Send(int fd, PeerTransfer& transfer) {
+        const auto result = write(fd, transfer.m_frame.data() + transfer.m_sent, transfer.m_frame.size() - transfer.m_sent);
+        if (!Interrupted(result)) {
+            transfer.m_sent += result;
+        }
+    }
+
+    static void Receive(int fd, PeerTransfer& transfer, Message& message) {
+        ssize_t result = 0;
+        if (transfer.m_header_received < sizeof(transfer.m_incoming_size)) {
+            const auto header = reinterpret_cast<char*>(&transfer.m_incoming_size);
+            result = read(fd, header + transfer.m_header_received, sizeof(transfer.m_incoming_size) - transfer.m_header_received);
+            if (!Interrupted(result) && result > 0) {
+                transfer.m_header_received += result;
+                if (transfer.m_header_received == sizeof(transfer.m_incoming_size)) {
+                    message.resize(transfer.m_incoming_size);
+                }
+            }
+        } else {
+            const auto payload = reinterpret_cast<char*>(message.data());
+            result = read(fd, payload + transfer.m_received, message.size() * sizeof(T) - transfer.m_received);
+            if (!Interrupted(result) && result > 0) {
+                transfer.m_received += result;
+            }
+        }
+
+        if (result == 0) {
+            throw std::runtime_error("worker disconnected during exchange");
+        }
+
+        transfer.m_receive_done = transfer.m_header_received == sizeof(transfer.m_incoming_size) &&
+            transfer.m_received == message.size() * sizeof(T);
+    }
+
+    std::vector<std::vector<int>> m_sockets;
+};
+
+typedef BasicUnixSocketTransport<int> UnixSocketTransport;
+
+// Graph split across worker_count shards, vertex v being owned by shard v % worker_count. A shard
+// only holds the out-edges of its own vertices as CSR over local ids: ids below the number of
+// owned vertices are owned vertices, the rest index the shard's ghost list of remote vertices.
+// That way a worker only ever needs its own shard in memory.
+template <typename V>
+class BasicPartitionedGraph
+{
+public:
+    typedef V VertexId;
+
+    class Shard {
+    public:
+        VertexId GetOwnedCount() const {
+            return m_adjacency.GetRowCount();
+        }
+
+        BasicCompressedSparseRows<VertexId> m_adjacency;
+        std::vector<VertexId> m_ghosts;
+    };
+
+    template <typename Graph>
+    BasicPartitionedGraph(Graph* graph, int worker_count) :
+        m_vertex_count(graph->GetVertexCount()),
+        m_shards(worker_count) {
+        for (int worker = 0; worker < worker_count; worker++) {
+            auto& shard = m_shards[worker];
+            std::unordered_map<VertexId, VertexId> ghost_ids;
+
+            // targets are global ids until all owned vertices have been seen and the ghost
+            // ids can be appended after them
+            for (std::size_t vertex = worker; vertex < static_cast<std::size_t>(m_vertex_count); vertex += worker_count) {
+                for (auto neighbour : graph->GetEdgesForVertex(static_cast<VertexId>(vertex))) {
+                    shard.m_adjacency.m_targets.push_back(neighbour);
+                    if (GetOwner(neighbour) != worker && ghost_ids.emplace(neighbour, shard.m_ghosts.size()).second) {
+                        shard.m_ghosts.push_back(neighbour);
+                    }
+                }
+                shard.m_adjacency.m_offsets.push_back(shard.m_adjacency.m_targets.size());
+            }
+
+            for (auto& target : shard.m_adjacency.m_targets) {
+                if (GetOwner(target) == worker) {
+                    target = GetLocalId(target);
+                } else {
+                    target = shard.GetOwnedCount() + ghost_ids[target];
+                }
+            }
+        }
+    }
+
+    int GetOwner(VertexId vertex) const {
+        return vertex % GetWorkerCount();
+    }
+
+    VertexId GetLocalId(VertexId vertex) const {
+        return vertex / GetWorkerCount();
+    }
+
+    VertexId GetGlobalId(int worker, VertexId local_id) const {
+        return local_id * GetWorkerCount() + worker;
+    }
+
+    int GetWorkerCount() const {
+        return m_shards.size();
+    }
+
+    VertexId GetVertexCount() const {
+        return m_vertex_count;
+    }
+
+    const Shard& GetShard(int worker) const {
+        return m_shards[worker];
+    }
+
+private:
+
+    VertexId m_vertex_count;
+    std::vector<Shard> m_shards;
+};
+
+typedef BasicPartitionedGraph<int> PartitionedGraph;
+
+// Tells every worker whether any worker still has work to do.
+template <typename T>
+bool any_worker_active(IBasicMessageTransport<T>& transport, int worker, bool active) {
+    std::vector<std::vector<T>> outgoing(transport.GetWorkerCount(), std::vector<T>{ static_cast<T>(active) });
+    for (const auto& message : transport.Exchange(worker, std::move(outgoing))) {
+        if (message[0]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Level-synchronous BFS for one worker. Returns the depth of every vertex the worker owns (by
+// local id), or -1 for vertices that can't be reached from start_vertex.
+template <typename VertexId>
+std::vector<int> partitioned_bfs_worker(
+    const BasicPartitionedGraph<VertexId>& graph,
+    IBasicMessageTransport<VertexId>& transport,
+    int worker,
+    typename BasicPartitionedGraph<VertexId>::VertexId start_vertex
+) {
+    const auto& shard = graph.GetShard(worker);
+    const VertexId owned_count = shard.GetOwnedCount();
+
+    std::vector<int> depths(owned_count, -1);
+    std::vector<char> ghost_sent(shard.m_ghosts.size(), 0);
+    std::vector<VertexId> frontier;
+    if (graph.GetOwner(start_vertex) == worker) {
+        depths[graph.GetLocalId(start_vertex)] = 0;
+        frontier.push_back(graph.GetLocalId(start_vertex));
+    }
+
+    for (int depth = 1; any_worker_active(transport, worker, !frontier.empty()); depth++) {
+        std::vector<VertexId> next_frontier;
+        std::vector<std::vector<VertexId>> outgoing(graph.GetWorkerCount());
+
+        for (auto vertex : frontier) {
+            for (auto target = shard.m_adjacency.Begin(vertex); target != shard.m_adjacency.End(vertex); target++) {
+                if (*target < owned_count) {
+                    if (depths[*target] == -1) {
+                        depths[*target] = depth;
+                        next_frontier.push_back(*target);
+                    }
+                    continue;
+                }
+
+                // a ghost only needs announcing to its owner the first time it is reached
+                const VertexId ghost = *target - owned_count;
+                if (!ghost_sent[ghost]) {
+                    ghost_sent[ghost] = 1;
+                    const VertexId global_id = shard.m_ghosts[ghost];
+                    outgoing[graph.GetOwner(global_id)].push_back(graph.GetLocalId(global_id));
+                }
+            }
+        }
+
+        for (const auto& message : transport.Exchange(worker, std::move(outgoing))) {
+            for (auto vertex : message) {
+                if (depths[vertex] == -1) {
+                    depths[vertex] = depth;
+                    next_frontier.push_back(vertex);
+                }
+            }
+        }
+
+        frontier.swap(next_frontier);
+    }
+
+    return depths;
+}
+
+// Connected components for one worker by min-label propagation: every vertex ends up labelled
+// with the smallest vertex id in its component. Expects an undirected graph. Returns the labels of
+// the vertices the worker owns, by local id.
+template <typename VertexId>
+std::vector<VertexId> partitioned_connected_components_worker(
+    const BasicPartitionedGraph<VertexId>& graph,
+    IBasicMessageTransport<VertexId>& transport,
+    int worker
+) {
+    const auto& shard = graph.GetShard(worker);
+    const VertexId owned_count = shard.GetOwnedCount();
+
+    std::vector<VertexId> labels(owned_count);
+    std::vector<VertexId> active(owned_count);
+    for (VertexId i = 0; i < owned_count; i++) {
+        labels[i] = graph.GetGlobalId(worker, i);
+        active[i] = i;
+    }
+
+    // smallest label already sent to each ghost's owner
+    std::vector<VertexId> ghost_labels(shard.m_ghosts.size(), std::numeric_limits<VertexId>::max());
+    std::vector<char> in_next(owned_count, 0);
+
+    while (any_worker_active(transport, worker, !active.empty())) {
+        std::vector<VertexId> next_active;
+        auto lower = [&] (VertexId vertex, VertexId label) {
+            if (label < labels[vertex]) {
+                labels[vertex] = label;
+                if (!in_next[vertex]) {
+                    in_next[vertex] = 1;
+                    next_active.push_back(vertex);
+                }
+            }
+        };
+
+        std::vector<VertexId> dirty_ghosts;
+        for (auto vertex : active) {
+            for (auto target = shard.m_adjacency.Begin(vertex); target != shard.m_adjacency.End(vertex); target++) {
+                if (*target < owned_count) {
+                    lower(*target, labels[vertex]);
+                    continue;
+                }
+
+                const VertexId ghost = *target - owned_count;
+                if (labels[vertex] < ghost_labels[ghost]) {
+                    ghost_labels[ghost] = labels[vertex];
+                    dirty_ghosts.push_back(ghost);
+                }
+            }
+        }
+
+        std::vector<std::vector<VertexId>> outgoing(graph.GetWorkerCount());
+        std::sort(dirty_ghosts.begin(), dirty_ghosts.end());
+        dirty_ghosts.erase(std::unique(dirty_ghosts.begin(), dirty_ghosts.end()), dirty_ghosts.end());
+        for (auto ghost : dirty_ghosts) {
+            const VertexId global_id = shard.m_ghosts[ghost];
+            auto& message = outgoing[graph.GetOwner(global_id)];
+            message.push_back(graph.GetLocalId(global_id));
+            message.push_back(ghost_labels[ghost]);
+        }
+
+        for (const auto& message : transport.Exchange(worker, std::move(outgoing))) {
+            for (std::size_t i = 0; i < message.size(); i += 2) {
+                lower(message[i], message[i + 1]);
+            }
+        }
+
+        for (auto vertex : next_active) {
+            in_next[vertex] = 0;
+        }
+        active.swap(next_active);
+    }
+
+    return labels;
+}
+
+// Runs worker(0) .. worker(worker_count - 1) on a thread each and waits for all of them.
+void run_workers(int worker_count, const std::function<void (int)>& worker) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < worker_count; i++) {
+        threads.emplace_back(worker, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Runs partitioned_bfs_worker() for every shard on its own thread and gathers the depths of all
+// vertices by global id.
+template <typename VertexId>
+std::vector<int> partitioned_bfs(
+    const BasicPartitionedGraph<VertexId>& graph,
+    IBasicMessageTransport<VertexId>& transport,
+    typename BasicPartitionedGraph<VertexId>::VertexId start_vertex = 0
+) {
+    std::vector<int> depths(graph.GetVertexCount(), -1);
+    run_workers(graph.GetWorkerCount(), [&] (int worker) {
+        const auto local_depths = partitioned_bfs_worker(graph, transport, worker, start_vertex);
+        for (std::size_t i = 0; i < local_depths.size(); i++) {
+            depths[graph.GetGlobalId(worker, i)] = local_depths[i];
+        }
+    });
+
+    return depths;
+}
+
+template <typename VertexId>
+std::vector<VertexId> partitioned_connected_components(
+    const BasicPartitionedGraph<VertexId>& graph,
+    IBasicMessageTransport<VertexId>& transport
+) {
+    std::vector<VertexId> labels(graph.GetVertexCount(), null_vertex<VertexId>());
+    run_workers(graph.GetWorkerCount(), [&] (int worker) {
+        const auto local_labels = partitioned_connected_components_worker(graph, transport, worker);
+        for (std::size_t i = 0; i < local_labels.size(); i++) {
+            labels[graph.GetGlobalId(worker, i)] = local_labels[i];
+        }
+    });
+
+    return labels;
+}
+
+// Coreness of every vertex: the largest k such that the vertex belongs to a subgraph in which
+// every vertex has degree at least k. Uses the linear time bucket-based peeling of Batagelj and
+// Zaversnik. Degrees count every entry of a vertex's adjacency list.
+template <typename Graph>
+std::vector<int> core_numbers(Graph* graph) {
+    typedef typename Graph::VertexId VertexId;
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    const VertexId vertex_count = adjacency.GetRowCount();
+
+    std::vector<int> degrees(vertex_count);
+    int max_degree = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; vertex++) {
+        degrees[vertex] = adjacency.GetDegree(vertex);
+        max_degree = std::max(max_degree, degrees[vertex]);
+    }
+
+    // vertices sorted by degree with a counting sort, bin_starts[d] being where degree d begins
+    std::vector<VertexId> bin_starts(max_degree + 2, 0);
+    for (auto degree : degrees) {
+        bin_starts[degree + 1]++;
+    }
+    std::partial_sum(bin_starts.begin(), bin_starts.end(), bin_starts.begin());
+
+    std::vector<VertexId> sorted(vertex_count);
+    std::vector<VertexId> positions(vertex_count);
+    std::vector<VertexId> cursors(bin_starts.begin(), bin_starts.end() - 1);
+    for (VertexId vertex = 0; vertex < vertex_count; vertex++) {
+        positions[vertex] = cursors[degrees[vertex]]++;
+        sorted[positions[vertex]] = vertex;
+    }
+
+    // peel the vertex of smallest remaining degree; each neighbour of higher degree moves down
+    // one bin by swapping it with the first vertex of its bin
+    for (VertexId i = 0; i < vertex_count; i++) {
+        const VertexId vertex = sorted[i];
+        for (auto neighbour = adjacency.Begin(vertex); neighbour != adjacency.End(vertex); neighbour++) {
+            const VertexId u = *neighbour;
+            if (degrees[u] <= degrees[vertex]) {
+                continue;
+            }
+
+            const VertexId bin_start = bin_starts[degrees[u]];
+            const VertexId w = sorted[bin_start];
+            if (u != w) {
+                std::swap(sorted[positions[u]], sorted[bin_start]);
+                std::swap(positions[u], positions[w]);
+            }
+            bin_starts[degrees[u]]++;
+            degrees[u]--;
+        }
+    }
+
+    return degrees;
+}
+
+// Same result as core_numbers(), peeling a whole frontier of vertices at once: all remaining
+// vertices of degree <= k are removed in parallel, their neighbours' degrees are decremented
+// atomically and whoever drops a neighbour to k adds it to the next frontier. Vertices wait in
+// buckets by degree, filed again only when a round changes their degree, so every round costs
+// time in proportion to the vertices it touches rather than to those left in the graph. Each
+// thread keeps its own set of buckets, so filing is parallel too.
+template <typename Graph>
+std::vector<int> core_numbers_parallel(Graph* graph, int thread_count = default_thread_count()) {
+    typedef typename Graph::VertexId VertexId;
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    const VertexId vertex_count = adjacency.GetRowCount();
+
+    // side by side, so that marking a vertex touched costs no extra cache miss
+    class Counter {
+    public:
+        std::atomic<int> m_degree;
+        // the last k whose round changed the degree
+        std::atomic<int> m_touched_in;
+    };
+
+    std::vector<Counter> counters(vertex_count);
+    std::vector<int> cores(vertex_count, 0);
+    std::vector<char> removed(vertex_count, 0);
+    int max_degree = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; vertex++) {
+        counters[vertex].m_degree.store(adjacency.GetDegree(vertex));
+        counters[vertex].m_touched_in.store(-1);
+        max_degree = std::max(max_degree, counters[vertex].m_degree.load());
+    }
+
+    // buckets[slice][d] holds vertices whose degree is d, and possibly stale entries for vertices
+    // that have since been removed or moved to a lower bucket; slice i of a list is filed by
+    // thread i into its own buckets
+    const std::size_t slice_count = std::max(thread_count, 1);
+    std::vector<std::vector<std::vector<VertexId>>> buckets(slice_count, std::vector<std::vector<VertexId>>(max_degree + 1));
+    parallel_for(slice_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+        for (std::size_t slice = begin; slice < end; slice++) {
+            const std::size_t last = vertex_count * (slice + 1) / slice_count;
+            for (std::size_t vertex = vertex_count * slice / slice_count; vertex < last; vertex++) {
+                buckets[slice][counters[vertex].m_degree.load()].push_back(static_cast<VertexId>(vertex));
+            }
+        }
+    });
+
+    std::mutex frontier_mutex;
+    for (int k = 0; k <= max_degree; k++) {
+        std::vector<VertexId> frontier;
+        parallel_for(slice_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            std::vector<VertexId> found;
+            for (std::size_t slice = begin; slice < end; slice++) {
+                for (auto vertex : buckets[slice][k]) {
+                    if (!removed[vertex] && counters[vertex].m_degree.load() == k) {
+                        found.push_back(vertex);
+                    }
+                }
+                std::vector<VertexId>().swap(buckets[slice][k]);
+            }
+
+            std::lock_guard<std::mutex> lock(frontier_mutex);
+            frontier.insert(frontier.end(), found.begin(), found.end());
+        });
+
+        std::vector<VertexId> touched;
+        while (!frontier.empty()) {
+            for (auto vertex : frontier) {
+                cores[vertex] = k;
+                removed[vertex] = 1;
+            }
+
+            std::vector<VertexId> next_frontier;
+            parallel_for(frontier.size(), thread_count, [&] (std::size_t begin, std::size_t end) {
+                std::vector<VertexId> found;
+                std::vector<VertexId> changed;
+                for (std::size_t i = begin; i < end; i++) {
+                    const VertexId vertex = frontier[i];
+                    for (auto neighbour = adjacency.Begin(vertex); neighbour != adjacency.End(vertex); neighbour++) {
+                        if (removed[*neighbour]) {
+                            continue;
+                        }
+                        Counter& counter = counters[*neighbour];
+                        if (counter.m_degree.fetch_sub(1) == k + 1) {
+                            found.push_back(*neighbour);
+                        } else if (counter.m_touched_in.load(std::memory_order_relaxed) != k && counter.m_touched_in.exchange(k) != k) {
+                            changed.push_back(*neighbour);
+                        }
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(frontier_mutex);
+                next_frontier.insert(next_frontier.end(), found.begin(), found.end());
+                touched.insert(touched.end(), changed.begin(), changed.end());
+            });
+
+            frontier.swap(next_frontier);
+        }
+
+        // file the vertices this round left with a lower degree under that degree
+        parallel_for(slice_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t slice = begin; slice < end; slice++) {
+                const std::size_t last = touched.size() * (slice + 1) / slice_count;
+                for (std::size_t i = touched.size() * slice / slice_count; i < last; i++) {
+                    const int degree = counters[touched[i]].m_degree.load();
+                    if (!removed[touched[i]] && degree > k) {
+                        buckets[slice][degree].push_back(touched[i]);
+                    }
+                }
+            }
+        });
+    }
+
+    return cores;
+}
+
+// Community detection by asynchronous label propagation. Every vertex starts in its own community
+// and repeatedly adopts the label that is most common among its neighbours, keeping its current
+// label on ties if it can. Threads update labels in place and see each other's updates within a
+// sweep. Stops once a sweep changes fewer than convergence_threshold * vertex count labels, or
+// after max_iterations sweeps. Returns the community label of every vertex.
+template <typename Graph>
+std::vector<typename Graph::VertexId> label_propagation_communities(
+    Graph* graph,
+    double convergence_threshold = 0.0001,
+    int max_iterations = 100,
+    int thread_count = default_thread_count()
+) {
+    typedef typename Graph::VertexId VertexId;
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    const std::size_t vertex_count = adjacency.GetRowCount();
+    thread_count = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, vertex_count));
+
+    std::vector<std::atomic<VertexId>> labels(vertex_count);
+    std::vector<VertexId> order(vertex_count);
+    for (std::size_t vertex = 0; vertex < vertex_count; vertex++) {
+        labels[vertex].store(vertex, std::memory_order_relaxed);
+        order[vertex] = vertex;
+    }
+
+    // visiting vertices in random order avoids sweeping labels along the vertex ids
+    std::mt19937 generator(vertex_count);
+    std::shuffle(order.begin(), order.end(), generator);
+
+    // one dense histogram per thread, indexed by label. Only the touched entries are reset.
+    std::vector<std::vector<int>> histograms(thread_count, std::vector<int>(vertex_count, 0));
+
+    for (int iteration = 0; iteration < max_iterations; iteration++) {
+        std::atomic<std::size_t> changed(0);
+
+        parallel_for(thread_count, thread_count, [&] (std::size_t thread_begin, std::size_t thread_end) {
+            for (std::size_t thread = thread_begin; thread < thread_end; thread++) {
+                auto& counts = histograms[thread];
+                std::vector<VertexId> touched;
+                std::size_t thread_changed = 0;
+
+                const std::size_t begin = vertex_count * thread / thread_count;
+                const std::size_t end = vertex_count * (thread + 1) / thread_count;
+                for (std::size_t i = begin; i < end; i++) {
+                    const VertexId vertex = order[i];
+                    if (adjacency.GetDegree(vertex) == 0) {
+                        continue;
+                    }
+
+                    for (auto neighbour = adjacency.Begin(vertex); neighbour != adjacency.End(vertex); neighbour++) {
+                        const VertexId label = labels[*neighbour].load(std::memory_order_relaxed);
+                        if (counts[label]++ == 0) {
+                            touched.push_back(label);
+                        }
+                    }
+
+                    const VertexId current = labels[vertex].load(std::memory_order_relaxed);
+                    VertexId best = current;
+                    int best_count = counts[current];
+                    for (auto label : touched) {
+                        if (counts[label] > best_count || (counts[label] == best_count && label < best && best != current)) {
+                            best = label;
+                            best_count = counts[label];
+                        }
+                        counts[label] = 0;
+                    }
+                    touched.clear();
+
+                    if (best != current) {
+                        labels[vertex].store(best, std::memory_order_relaxed);
+                        thread_changed++;
+                    }
+                }
+
+                changed += thread_changed;
+            }
+        });
+
+        if (changed.load() <= convergence_threshold * vertex_count) {
+            break;
+        }
+    }
+
+    std::vector<VertexId> result(vertex_count);
+    for (std::size_t vertex = 0; vertex < vertex_count; vertex++) {
+        result[vertex] = labels[vertex].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// Traversal buffers for Brandes' algorithm that are reused from one source to the next. Only the
+// entries a traversal reached are reset afterwards, so a source that reaches a small part of the
+// graph doesn't pay for the rest of it.
+template <typename VertexId>
+class BrandesWorkspace
+{
+public:
+    BrandesWorkspace(std::size_t vertex_count) :
+        m_distances(vertex_count, -1),
+        m_path_counts(vertex_count, 0),
+        m_dependencies(vertex_count, 0) {
+        m_order.reserve(vertex_count);
+    }
+
+    // Adds the dependencies of every vertex on source to centrality.
+    void Accumulate(const BasicCompressedSparseRows<VertexId>& adjacency, VertexId source, std::vector<double>& centrality) {
+        // BFS counting shortest paths; m_order doubles as the queue
+        m_distances[source] = 0;
+        m_path_counts[source] = 1;
+        m_order.push_back(source);
+        for (std::size_t head = 0; head < m_order.size(); head++) {
+            const VertexId vertex = m_order[head];
+            for (auto neighbour = adjacency.Begin(vertex); neighbour != adjacency.End(vertex); neighbour++) {
+                if (m_distances[*neighbour] < 0) {
+                    m_distances[*neighbour] = m_distances[vertex] + 1;
+                    m_order.push_back(*neighbour);
+                }
+                if (m_distances[*neighbour] == m_distances[vertex] + 1) {
+                    m_path_counts[*neighbour] += m_path_counts[vertex];
+                }
+            }
+        }
+
+        // in reverse BFS order every successor's dependency is final before it is used, so the
+        // successors can be found from the out-edges again instead of storing predecessor lists
+        for (std::size_t i = m_order.size(); i-- > 0;) {
+            const VertexId vertex = m_order[i];
+            for (auto neighbour = adjacency.Begin(vertex); neighbour != adjacency.End(vertex); neighbour++) {
+                if (m_distances[*neighbour] == m_distances[vertex] + 1) {
+                    m_dependencies[vertex] +=
+                        m_path_counts[vertex] / m_path_counts[*neighbour] * (1 + m_dependencies[*neighbour]);
+                }
+            }
+            if (vertex != source) {
+                centrality[vertex] += m_dependencies[vertex];
+            }
+        }
+
+        for (auto vertex : m_order) {
+            m_distances[vertex] = -1;
+            m_path_counts[vertex] = 0;
+            m_dependencies[vertex] = 0;
+        }
+        m_order.clear();
+    }
+
+private:
+
+    std::vector<std::int64_t> m_distances;
+    std::vector<double> m_path_counts;
+    std::vector<double> m_dependencies;
+    std::vector<VertexId> m_order;
+};
+
+// Sums the dependencies on every source in sources. Each thread handles a share of the sources
+// with its own workspace and accumulator; the accumulators are added up at the end.
+template <typename VertexId>
+std::vector<double> brandes_betweenness(
+    const BasicCompressedSparseRows<VertexId>& adjacency,
+    const std::vector<VertexId>& sources,
+    int thread_count
+) {
+    const std::size_t vertex_count = adjacency.GetRowCount();
+    std::vector<double> centrality(vertex_count, 0);
+    std::mutex centrality_mutex;
+
+    parallel_for(sources.size(), thread_count, [&] (std::size_t begin, std::size_t end) {
+        BrandesWorkspace<VertexId> workspace(vertex_count);
+        std::vector<double> local_centrality(vertex_count, 0);
+        for (std::size_t i = begin; i < end; i++) {
+            workspace.Accumulate(adjacency, sources[i], local_centrality);
+        }
+
+        std::lock_guard<std::mutex> lock(centrality_mutex);
+        for (std::size_t vertex = 0; vertex < vertex_count; vertex++) {
+            centrality[vertex] += local_centrality[vertex];
+        }
+    });
+
+    return centrality;
+}
+
+// Betweenness centrality of every vertex (Brandes), counting shortest paths without weights. In
+// an undirected graph every path is counted from both of its ends, so halve the values for the
+// usual undirected definition.
+template <typename Graph>
+std::vector<double> betweenness_centrality(Graph* graph, int thread_count = default_thread_count()) {
+    typedef typename Graph::VertexId VertexId;
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    std::vector<VertexId> sources(adjacency.GetRowCount());
+    std::iota(sources.begin(), sources.end(), 0);
+
+    return brandes_betweenness(adjacency, sources, thread_count);
+}
+
+// Estimate of betweenness_centrality() from sample_count distinct sources picked at random, scaled
+// up by vertex count / sample_count. Runs in O(sample_count * edges) whatever the graph size.
+template <typename Graph>
+std::vector<double> approximate_betweenness_centrality(
+    Graph* graph,
+    std::size_t sample_count,
+    unsigned int seed = 1,
+    int thread_count = default_thread_count()
+) {
+    typedef typename Graph::VertexId VertexId;
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    const std::size_t vertex_count = adjacency.GetRowCount();
+    sample_count = std::min(sample_count, vertex_count);
+    if (sample_count == 0) {
+        return std::vector<double>(vertex_count, 0);
+    }
+
+    // partial Fisher-Yates shuffle for the sample
+    std::vector<VertexId> sources(vertex_count);
+    std::iota(sources.begin(), sources.end(), 0);
+    std::mt19937_64 generator(seed);
+    for (std::size_t i = 0; i < sample_count; i++) {
+        std::uniform_int_distribution<std::size_t> pick(i, vertex_count - 1);
+        std::swap(sources[i], sources[pick(generator)]);
+    }
+    sources.resize(sample_count);
+
+    auto centrality = brandes_betweenness(adjacency, sources, thread_count);
+    const double scale = static_cast<double>(vertex_count) / sample_count;
+    for (auto& value : centrality) {
+        value *= scale;
+    }
+
+    return centrality;
+}
+
+// Result of biconnectivity(). Articulation points are in ascending order, bridges are (smaller,
+// larger) pairs in ascending order, and each biconnected component lists its vertices in no
+// particular order. A vertex appears in every component it belongs to; isolated vertices belong to
+// none.
+template <typename V>
+class BasicBiconnectivity
+{
+public:
+    typedef V VertexId;
+
+    std::vector<VertexId> m_articulation_points;
+    std::vector<std::pair<VertexId, VertexId>> m_bridges;
+    std::vector<std::vector<VertexId>> m_components;
+};
+
+typedef BasicBiconnectivity<int> Biconnectivity;
+
+// Articulation points, bridges and biconnected components of an undirected graph (Hopcroft-Tarjan
+// low-link values) in O(V + E). The DFS keeps its own stack of frames rather than recursing, so
+// path-like graphs with millions of vertices are fine. Parallel edges are honoured: only the edge
+// a vertex was reached by is skipped, not every edge back to its parent.
+template <typename Graph>
+BasicBiconnectivity<typename Graph::VertexId> biconnectivity(Graph* graph) {
+    typedef typename Graph::VertexId VertexId;
+
+    class Frame {
+    public:
+        VertexId m_vertex;
+        VertexId m_parent;
+        std::size_t m_next;
+        bool m_skipped_parent;
+    };
+
+    const auto adjacency = to_compressed_sparse_rows(graph);
+    const std::size_t vertex_count = adjacency.GetRowCount();
+    const VertexId none = null_vertex<VertexId>();
+
+    // discovery times start at 1 so that 0 means undiscovered
+    std::vector<std::size_t> discovered(vertex_count, 0);
+    std::vector<std::size_t> low(vertex_count, 0);
+    std::vector<bool> articulation(vertex_count, false);
+    std::vector<std::size_t> component_stamp(vertex_count, 0);
+    std::vector<Frame> frames;
+    std::vector<std::pair<VertexId, VertexId>> edge_stack;
+    std::size_t time = 0;
+
+    BasicBiconnectivity<VertexId> result;
+    for (std::size_t start = 0; start < vertex_count; start++) {
+        if (discovered[start] != 0 || adjacency.GetDegree(start) == 0) {
+            continue;
+        }
+
+        const VertexId root = static_cast<VertexId>(start);
+        std::size_t root_children = 0;
+        discovered[root] = low[root] = ++time;
+        frames.push_back(Frame { root, none, adjacency.m_offsets[root], false });
+
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            const VertexId vertex = frame.m_vertex;
+
+            if (frame.m_next < adjacency.m_offsets[vertex + 1]) {
+                const VertexId neighbour = adjacency.m_targets[frame.m_next++];
+                if (neighbour == frame.m_parent && !frame.m_skipped_parent) {
+                    frame.m_skipped_parent = true;
+                } else if (discovered[neighbour] == 0) {
+                    if (vertex == root) {
+                        root_children++;
+                    }
+                    edge_stack.emplace_back(vertex, neighbour);
+                    discovered[neighbour] = low[neighbour] = ++time;
+                    // invalidates frame
+                    frames.push_back(Frame { neighbour, vertex, adjacency.m_offsets[neighbour], false });
+                } else if (discovered[neighbour] < discovered[vertex]) {
+                    edge_stack.emplace_back(vertex, neighbour);
+                    low[vertex] = std::min(low[vertex], discovered[neighbour]);
+                }
+                continue;
+            }
+
+            const VertexId parent = frame.m_parent;
+            frames.pop_back();
+            if (parent == none) {
+                continue;
+            }
+
+            low[parent] = std::min(low[parent], low[vertex]);
+            if (low[vertex] > discovered[parent]) {
+                result.m_bridges.emplace_back(std::min(parent, vertex), std::max(parent, vertex));
+            }
+            if (low[vertex] >= discovered[parent]) {
+                // parent separates vertex's subtree from the rest, so the edges pushed since
+                // (parent, vertex) form one component
+                if (parent != root) {
+                    articulation[parent] = true;
+                }
+
+                const std::size_t stamp = result.m_components.size() + 1;
+                std::vector<VertexId> component;
+                std::pair<VertexId, VertexId> edge;
+                do {
+                    edge = edge_stack.back();
+                    edge_stack.pop_back();
+                    for (auto end : { edge.first, edge.second }) {
+                        if (component_stamp[end] != stamp) {
+                            component_stamp[end] = stamp;
+                            component.push_back(end);
+                        }
+                    }
+                } while (edge != std::make_pair(parent, vertex));
+                result.m_components.push_back(std::move(component));
+            }
+        }
+
+        if (root_children > 1) {
+            articulation[root] = true;
+        }
+    }
+
+    for (std::size_t vertex = 0; vertex < vertex_count; vertex++) {
+        if (articulation[vertex]) {
+            result.m_articulation_points.push_back(static_cast<VertexId>(vertex));
+        }
+    }
+    std::sort(result.m_bridges.begin(), result.m_bridges.end());
+
+    return result;
+}
+
+// A subgraph relabelled to local ids 0..n-1. Row i of m_rows holds the neighbours of the vertex
+// whose id in the original graph is m_global_ids[i], already translated to local ids.
+template <typename V>
+class BasicSubgraph
+{
+public:
+    typedef V VertexId;
+
+    BasicCompressedSparseRows<VertexId> m_rows;
+    std::vector<VertexId> m_global_ids;
+};
+
+typedef BasicSubgraph<int> Subgraph;
+
+// Extracts induced subgraphs and k-hop neighbourhoods from one graph. The global to local id
+// table is a flat array over the whole graph that is allocated once; each extraction only resets
+// the entries it set, so extracting many small neighbourhoods costs in proportion to their size.
+template <typename Graph>
+class SubgraphExtractor
+{
+public:
+    typedef typename Graph::VertexId VertexId;
+
+    SubgraphExtractor(Graph* graph, int thread_count = default_thread_count()) :
+        m_graph(graph),
+        m_thread_count(thread_count),
+        m_local_ids(graph->GetVertexCount(), null_vertex<VertexId>()) {
+    }
+
+    // The subgraph made of vertices and every edge between two of them. Repeated vertices are
+    // ignored; local ids follow the order of first appearance.
+    BasicSubgraph<VertexId> Induced(const std::vector<VertexId>& vertices) {
+        BasicSubgraph<VertexId> subgraph;
+        for (auto vertex : vertices) {
+            Select(vertex, subgraph.m_global_ids);
+        }
+        Build(subgraph);
+        return subgraph;
+    }
+
+    // The subgraph induced by every vertex at most hops edges from one of the seeds, following
+    // edges in their stored direction. Seeds get the first local ids, then the vertices one hop
+    // away, and so on.
+    BasicSubgraph<VertexId> KHop(const std::vector<VertexId>& seeds, std::size_t hops) {
+        BasicSubgraph<VertexId> subgraph;
+        for (auto seed : seeds) {
+            Select(seed, subgraph.m_global_ids);
+        }
+
+        // the global ids double as the BFS queue, one hop at a time
+        std::size_t frontier_begin = 0;
+        for (std::size_t hop = 0; hop < hops; hop++) {
+            const std::size_t frontier_end = subgraph.m_global_ids.size();
+            if (frontier_begin == frontier_end) {
+                break;
+            }
+            for (std::size_t i = frontier_begin; i < frontier_end; i++) {
+                for (auto neighbour : m_graph->GetEdgesForVertex(subgraph.m_global_ids[i])) {
+                    Select(neighbour, subgraph.m_global_ids);
+                }
+            }
+            frontier_begin = frontier_end;
+        }
+
+        Build(subgraph);
+        return subgraph;
+    }
+
+private:
+
+    void Select(VertexId vertex, std::vector<VertexId>& global_ids) {
+        if (m_local_ids[vertex] == null_vertex<VertexId>()) {
+            m_local_ids[vertex] = static_cast<VertexId>(global_ids.size());
+            global_ids.push_back(vertex);
+        }
+    }
+
+    // Fills in the rows of the selected vertices, then clears their entries in m_local_ids.
+    void Build(BasicSubgraph<VertexId>& subgraph) {
+        const std::size_t vertex_count = subgraph.m_global_ids.size();
+        auto& rows = subgraph.m_rows;
+        rows.m_offsets.assign(vertex_count + 1, 0);
+
+        // small subgraphs aren't worth starting threads for
+        const int thread_count = vertex_count >= (1 << 12) ? m_thread_count : 1;
+
+        // first pass: each chunk of rows is translated into a buffer of its own and its degrees
+        // recorded; second pass: the buffers are copied into place once the offsets are known
+        std::vector<std::pair<std::size_t, std::vector<VertexId>>> chunks;
+        std::mutex chunks_mutex;
+        parallel_for(vertex_count, thread_count, [&] (std::size_t begin, std::size_t end) {
+            std::vector<VertexId> targets;
+            for (std::size_t row = begin; row < end; row++) {
+                const std::size_t row_begin = targets.size();
+                for (auto neighbour : m_graph->GetEdgesForVertex(subgraph.m_global_ids[row])) {
+                    if (m_local_ids[neighbour] != null_vertex<VertexId>()) {
+                        targets.push_back(m_local_ids[neighbour]);
+                    }
+                }
+                rows.m_offsets[row + 1] = targets.size() - row_begin;
+            }
+
+            std::lock_guard<std::mutex> lock(chunks_mutex);
+            chunks.emplace_back(begin, std::move(targets));
+        });
+
+        std::partial_sum(rows.m_offsets.begin(), rows.m_offsets.end(), rows.m_offsets.begin());
+        rows.m_targets.resize(rows.m_offsets.back());
+        parallel_for(chunks.size(), thread_count, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                std::copy(
+                    chunks[i].second.begin(),
+                    chunks[i].second.end(),
+                    rows.m_targets.begin() + rows.m_offsets[chunks[i].first]
+                );
+            }
+        });
+
+        for (auto vertex : subgraph.m_global_ids) {
+            m_local_ids[vertex] = null_vertex<VertexId>();
+        }
+    }
+
+    Graph* m_graph;
+    int m_thread_count;
+    std::vector<VertexId> m_local_ids;
+};
+
+template <typename Graph>
+BasicSubgraph<typename Graph::VertexId> induced_subgraph(
+    Graph* graph,
+    const std::vector<typename Graph::VertexId>& vertices,
+    int thread_count = default_thread_count()
+) {
+    return SubgraphExtractor<Graph>(graph, thread_count).Induced(vertices);
+}
+
+template <typename Graph>
+BasicSubgraph<typename Graph::VertexId> k_hop_subgraph(
+    Graph* graph,
+    const std::vector<typename Graph::VertexId>& seeds,
+    std::size_t hops,
+    int thread_count = default_thread_count()
+) {
+    return SubgraphExtractor<Graph>(graph, thread_count).KHop(seeds, hops);
+}
+
+// Directed network with integer arc capacities for maximum flow and minimum cut. Arcs are added
+// with AddArc(); the first call to MaxFlow() lays the residual graph out as flat arrays grouped by
+// tail vertex, every arc next to the index of its reverse, so that discharging a vertex walks
+// memory in order.
+template <typename V>
+class BasicFlowNetwork
+{
+public:
+    typedef V VertexId;
+    typedef std::int64_t Capacity;
+
+    BasicFlowNetwork(VertexId vertex_count) : m_vertex_count(vertex_count), m_built(false), m_max_label(0) {
+    }
+
+    VertexId GetVertexCount() const {
+        return m_vertex_count;
+    }
+
+    // Returns an id for the arc to pass to GetFlow(). Parallel and opposite arcs are fine.
+    std::size_t AddArc(VertexId from, VertexId to, Capacity capacity) {
+        if (m_built) {
+            throw std::logic_error("arcs can't be added after MaxFlow()");
+        }
+        if (capacity < 0) {
+            throw std::invalid_argument("arc capacities can't be negative");
+        }
+
+        m_tails.push_back(from);
+        m_heads.push_back(to);
+        m_capacities.push_back(capacity);
+        return m_tails.size() - 1;
+    }
+
+    // Value of a maximum flow from source to sink, computed by FIFO push-relabel with the global
+    // relabelling and gap heuristics. thread_count only applies to the breadth-first searches of
+    // the global relabelling; discharging vertices is always sequential. Each call starts from
+    // zero flow.
+    Capacity MaxFlow(VertexId source, VertexId sink, int thread_count = 1) {
+        Build();
+        std::copy(m_capacities.begin(), m_capacities.end(), m_residual.begin());
+        std::fill(m_excess.begin(), m_excess.end(), 0);
+        if (source == sink) {
+            return 0;
+        }
+
+        const std::size_t n = m_vertex_count;
+        const std::size_t arc_count = m_arc_heads.size();
+        std::queue<VertexId> active;
+        std::vector<char> queued(n, 0);
+        auto activate = [&] (VertexId vertex) {
+            if (!queued[vertex] && vertex != source && vertex != sink) {
+                queued[vertex] = 1;
+                active.push(vertex);
+            }
+        };
+
+        for (std::size_t arc = m_offsets[source]; arc < m_offsets[source + 1]; arc++) {
+            Push(arc, m_residual[arc]);
+            activate(m_arc_heads[arc]);
+        }
+        GlobalRelabel(source, sink, thread_count);
+
+        // relabelling work done since the last global relabel
+        std::size_t work = 0;
+        const std::size_t global_relabel_threshold = 6 * n + arc_count / 2;
+
+        while (!active.empty()) {
+            const VertexId vertex = active.front();
+            active.pop();
+            queued[vertex] = 0;
+
+            // discharge
+            while (m_excess[vertex] > 0 && m_labels[vertex] < 2 * n) {
+                if (m_current[vertex] == m_offsets[vertex + 1]) {
+                    work += Relabel(vertex) + 12;
+                    continue;
+                }
+
+                const std::size_t arc = m_current[vertex];
+                const VertexId head = m_arc_heads[arc];
+                if (m_residual[arc] > 0 && m_labels[vertex] == m_labels[head] + 1) {
+                    Push(arc, std::min(m_excess[vertex], m_residual[arc]));
+                    activate(head);
+                } else {
+                    m_current[vertex]++;
+                }
+            }
+
+            if (work > global_relabel_threshold) {
+                GlobalRelabel(source, sink, thread_count);
+                work = 0;
+            }
+        }
+
+        return m_excess[sink];
+    }
+
+    // Flow on an arc in the flow found by the last call to MaxFlow().
+    Capacity GetFlow(std::size_t arc) const {
+        const std::size_t position = m_positions[arc];
+        return m_capacities[position] - m_residual[position];
+    }
+
+    // Source side of a minimum cut after MaxFlow(): the vertices the source can still reach
+    // through arcs with spare capacity.
+    std::vector<bool> MinCut(VertexId source) const {
+        std::vector<bool> reachable(m_vertex_count, false);
+        std::vector<VertexId> to_process { source };
+        reachable[source] = true;
+        while (!to_process.empty()) {
+            const VertexId vertex = to_process.back();
+            to_process.pop_back();
+            for (std::size_t arc = m_offsets[vertex]; arc < m_offsets[vertex + 1]; arc++) {
+                if (m_residual[arc] > 0 && !reachable[m_arc_heads[arc]]) {
+                    reachable[m_arc_heads[arc]] = true;
+                    to_process.push_back(m_arc_heads[arc]);
+                }
+            }
+        }
+        return reachable;
+    }
+
+private:
+
+    // Lays out forward and reverse arcs grouped by tail with a counting sort.
+    void Build() {
+        if (m_built) {
+            return;
+        }
+        m_built = true;
+
+        const std::size_t n = m_vertex_count;
+        const std::size_t input_count = m_tails.size();
+        m_offsets.assign(n + 1, 0);
+        for (std::size_t i = 0; i < input_count; i++) {
+            m_offsets[m_tails[i] + 1]++;
+            m_offsets[m_heads[i] + 1]++;
+        }
+        std::partial_sum(m_offsets.begin(), m_offsets.end(), m_offsets.begin());
+
+        std::vector<std::size_t> next(m_offsets.begin(), m_offsets.end() - 1);
+        std::vector<Capacity> capacities(2 * input_count);
+        m_arc_heads.resize(2 * input_count);
+        m_reverse.resize(2 * input_count);
+        m_positions.resize(input_count);
+        for (std::size_t i = 0; i < input_count; i++) {
+            const std::size_t forward = next[m_tails[i]]++;
+            const std::size_t backward = next[m_heads[i]]++;
+            m_arc_heads[forward] = m_heads[i];
+            m_arc_heads[backward] = m_tails[i];
+            m_reverse[forward] = backward;
+            m_reverse[backward] = forward;
+            capacities[forward] = m_capacities[i];
+            capacities[backward] = 0;
+            m_positions[i] = forward;
+        }
+
+        m_capacities = std::move(capacities);
+        m_tails = std::vector<VertexId>();
+        m_heads = std::vector<VertexId>();
+        m_residual.resize(2 * input_count);
+        m_excess.resize(n);
+        m_labels.resize(n);
+        m_current.resize(n);
+        m_bucket_first.resize(n);
+        m_bucket_next.resize(n);
+        m_bucket_previous.resize(n);
+        m_claimed = std::unique_ptr<std::atomic<bool>[]>(new std::atomic<bool>[n]);
+    }
+
+    void Push(std::size_t arc, Capacity amount) {
+        m_residual[arc] -= amount;
+        m_residual[m_reverse[arc]] += amount;
+        m_excess[m_arc_heads[m_reverse[arc]]] -= amount;
+        m_excess[m_arc_heads[arc]] += amount;
+    }
+
+    // Lifts vertex to one above its lowest residual neighbour and applies the gap heuristic if
+    // that empties its old label. Returns the work done: arcs scanned, plus labels and vertices
+    // visited by the gap heuristic.
+    std::size_t Relabel(VertexId vertex) {
+        const std::size_t n = m_vertex_count;
+        const std::size_t old_label = m_labels[vertex];
+
+        std::size_t new_label = 2 * n;
+        for (std::size_t arc = m_offsets[vertex]; arc < m_offsets[vertex + 1]; arc++) {
+            if (m_residual[arc] > 0) {
+                new_label = std::min(new_label, m_labels[m_arc_heads[arc]] + 1);
+            }
+        }
+        SetLabel(vertex, new_label);
+        m_current[vertex] = m_offsets[vertex];
+        std::size_t work = m_offsets[vertex + 1] - m_offsets[vertex];
+
+        if (old_label < n && m_bucket_first[old_label] == no_vertex) {
+            // nothing above the gap can reach the sink any more
+            for (std::size_t label = old_label + 1; label <= m_max_label; label++) {
+                while (m_bucket_first[label] != no_vertex) {
+                    const std::size_t other = m_bucket_first[label];
+                    SetLabel(other, n + 1);
+                    m_current[other] = m_offsets[other];
+                    work++;
+                }
+                work++;
+            }
+            m_max_label = old_label;
+        }
+
+        return work;
+    }
+
+    // Vertices with labels below n are kept in a doubly linked list per label, so that the gap
+    // heuristic finds the vertices above a gap without looking at any others.
+    void SetLabel(std::size_t vertex, std::size_t label) {
+        const std::size_t n = m_vertex_count;
+        if (m_labels[vertex] < n) {
+            const std::size_t previous = m_bucket_previous[vertex];
+            const std::size_t next = m_bucket_next[vertex];
+            if (previous == no_vertex) {
+                m_bucket_first[m_labels[vertex]] = next;
+            } else {
+                m_bucket_next[previous] = next;
+            }
+            if (next != no_vertex) {
+                m_bucket_previous[next] = previous;
+            }
+        }
+
+        m_labels[vertex] = label;
+        if (label < n) {
+            AddToBucket(vertex);
+        }
+    }
+
+    void AddToBucket(std::size_t vertex) {
+        const std::size_t label = m_labels[vertex];
+        const std::size_t first = m_bucket_first[label];
+        m_bucket_previous[vertex] = no_vertex;
+        m_bucket_next[vertex] = first;
+        if (first != no_vertex) {
+            m_bucket_previous[first] = vertex;
+        }
+        m_bucket_first[label] = vertex;
+        m_max_label = std::max(m_max_label, label);
+    }
+
+    // Sets every label to the exact residual distance to the sink, or to n plus the distance to
+    // the source for vertices that can no longer reach the sink.
+    void GlobalRelabel(VertexId source, VertexId sink, int thread_count) {
+        const std::size_t n = m_vertex_count;
+        std::fill(m_labels.begin(), m_labels.end(), 2 * n);
+        for (std::size_t vertex = 0; vertex < n; vertex++) {
+            m_claimed[vertex].store(false, std::memory_order_relaxed);
+        }
+
+        ReverseBfs(sink, 0, thread_count);
+        ReverseBfs(source, n, thread_count);
+
+        std::fill(m_bucket_first.begin(), m_bucket_first.end(), no_vertex);
+        m_max_label = 0;
+        for (std::size_t vertex = 0; vertex < n; vertex++) {
+            if (m_labels[vertex] < n) {
+                AddToBucket(vertex);
+            }
+            m_current[vertex] = m_offsets[vertex];
+        }
+    }
+
+    // Labels every unclaimed vertex that has a residual path to root with base plus the length of
+    // the shortest such path, one level at a time. Large levels are split between threads, which
+    // claim vertices with an atomic flag so that each is labelled exactly once.
+    void ReverseBfs(VertexId root, std::size_t base, int thread_count) {
+        m_claimed[root].store(true, std::memory_order_relaxed);
+        m_labels[root] = base;
+
+        std::vector<VertexId> frontier { root };
+        std::mutex next_mutex;
+        for (std::size_t distance = base + 1; !frontier.empty(); distance++) {
+            std::vector<VertexId> next;
+            const int level_threads = frontier.size() >= (1 << 12) ? thread_count : 1;
+            parallel_for(frontier.size(), level_threads, [&] (std::size_t begin, std::size_t end) {
+                std::vector<VertexId> local_next;
+                for (std::size_t i = begin; i < end; i++) {
+                    const VertexId vertex = frontier[i];
+                    for (std::size_t arc = m_offsets[vertex]; arc < m_offsets[vertex + 1]; arc++) {
+                        // the reverse arc leads from neighbour to vertex
+                        const VertexId neighbour = m_arc_heads[arc];
+                        if (m_residual[m_reverse[arc]] > 0 &&
+                            !m_claimed[neighbour].load(std::memory_order_relaxed) &&
+                            !m_claimed[neighbour].exchange(true, std::memory_order_relaxed)) {
+                            m_labels[neighbour] = distance;
+                            local_next.push_back(neighbour);
+                        }
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(next_mutex);
+                next.insert(next.end(), local_next.begin(), local_next.end());
+            });
+            frontier.swap(next);
+        }
+    }
+
+    VertexId m_vertex_count;
+    bool m_built;
+
+    // arcs as added, until Build()
+    std::vector<VertexId> m_tails;
+    std::vector<VertexId> m_heads;
+
+    // residual graph: arcs of vertex v are [m_offsets[v], m_offsets[v + 1])
+    std::vector<std::size_t> m_offsets;
+    std::vector<VertexId> m_arc_heads;
+    std::vector<std::size_t> m_reverse;
+    std::vector<Capacity> m_capacities;
+    std::vector<Capacity> m_residual;
+    std::vector<std::size_t> m_positions;
+
+    // push-relabel state
+    std::vector<Capacity> m_excess;
+    std::vector<std::size_t> m_labels;
+    std::vector<std::size_t> m_current;
+    std::unique_ptr<std::atomic<bool>[]> m_claimed;
+
+    // per-label vertex lists for the gap heuristic
+    static const std::size_t no_vertex = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> m_bucket_first;
+    std::vector<std::size_t> m_bucket_next;
+    std::vector<std::size_t> m_bucket_previous;
+    std::size_t m_max_label;
+};
+
+template <typename V>
+const std::size_t BasicFlowNetwork<V>::no_vertex;
+
+typedef BasicFlowNetwork<int> FlowNetwork;
+
+class FileCloser
+{
+public:
+    void operator()(std::FILE* file) const {
+        std::fclose(file);
+    }
+};
+
+typedef std::unique_ptr<std::FILE, FileCloser> FileHandle;
+
+template <typename V>
+class BasicStreamEdge
+{
+public:
+    typedef V VertexId;
+
+    VertexId m_from;
+    VertexId m_to;
+};
+
+// Directed edges stored in a binary file as raw (from, to) records, for graphs whose edges don't
+// fit in memory. Edges can only be appended and read back front to back, so all I/O is sequential.
+template <typename V>
+class BasicEdgeFile
+{
+public:
+    typedef V VertexId;
+    typedef BasicStreamEdge<VertexId> Edge;
+
+    // Opens the edge file at path, creating it empty first if create is set.
+    BasicEdgeFile(const std::string& path, VertexId vertex_count, bool create) :
+        m_file(std::fopen(path.c_str(), create ? "w+b" : "r+b")),
+        m_vertex_count(vertex_count),
+        m_edge_count(0) {
+        if (!m_file) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+
+        if (std::fseek(m_file.get(), 0, SEEK_END) != 0) {
+            throw std::system_error(errno, std::generic_category(), "seek " + path);
+        }
+        m_edge_count = static_cast<std::size_t>(std::ftell(m_file.get())) / sizeof(Edge);
+    }
+
+    VertexId GetVertexCount() const {
+        return m_vertex_count;
+    }
+
+    std::size_t GetEdgeCount() const {
+        return m_edge_count;
+    }
+
+    void Append(const std::vector<std::pair<VertexId, VertexId>>& edges) {
+        std::vector<Edge> records;
+        records.reserve(edges.size());
+        for (const auto& edge : edges) {
+            records.push_back(Edge { edge.first, edge.second });
+        }
+
+        if (std::fseek(m_file.get(), 0, SEEK_END) != 0 ||
+            std::fwrite(records.data(), sizeof(Edge), records.size(), m_file.get()) != records.size()) {
+            throw std::system_error(errno, std::generic_category(), "write edges");
+        }
+        m_edge_count += records.size();
+    }
+
+    // Reads the edges in order, block_edges at a time, and calls body(edges, count) for each block.
+    void ForEachBlock(std::size_t block_edges, const std::function<void (const Edge*, std::size_t)>& body) {
+        if (std::fflush(m_file.get()) != 0 || std::fseek(m_file.get(), 0, SEEK_SET) != 0) {
+            throw std::system_error(errno, std::generic_category(), "rewind edges");
+        }
+
+        std::vector<Edge> block(std::max<std::size_t>(block_edges, 1));
+        for (std::size_t remaining = m_edge_count; remaining > 0;) {
+            const std::size_t count = std::min(block.size(), remaining);
+            if (std::fread(block.data(), sizeof(Edge), count, m_file.get()) != count) {
+                throw std::runtime_error("edge file is shorter than expected");
+            }
+            body(block.data(), count);
+            remaining -= count;
+        }
+    }
+
+private:
+
+    FileHandle m_file;
+    VertexId m_vertex_count;
+    std::size_t m_edge_count;
+};
+
+typedef BasicEdgeFile<int> EdgeFile;
+
+// Writes every edge of graph to a new edge file at path. Undirected edges are written both ways.
+template <typename Graph>
+BasicEdgeFile<typename Graph::VertexId> write_edge_file(Graph* graph, const std::string& path) {
+    typedef typename Graph::VertexId VertexId;
+
+    BasicEdgeFile<VertexId> file(path, graph->GetVertexCount(), true);
+    std::vector<std::pair<VertexId, VertexId>> edges;
+    for (VertexId vertex = 0; vertex < graph->GetVertexCount(); vertex++) {
+        for (auto edge : graph->GetEdgesForVertex(vertex)) {
+            edges.emplace_back(vertex, edge);
+        }
+        if (edges.size() >= (1 << 16)) {
+            file.Append(edges);
+            edges.clear();
+        }
+    }
+    file.Append(edges);
+    return file;
+}
+
+class StreamOptions
+{
+public:
+    // edges read from the file per block
+    std::size_t m_block_edges = 1 << 20;
+    // vertices per partition; a partition's state should fit in cache
+    std::size_t m_partition_vertices = 1 << 16;
+    // updates a partition holds in memory before they are spilled to a temporary file
+    std::size_t m_buffered_updates = 1 << 16;
+    // threads for the gather phase, which works on one partition per thread
+    int m_thread_count = default_thread_count();
+};
+
+// Edge-centric scatter-gather engine in the style of X-Stream. Vertex state lives in memory, in
+// the program; edges are streamed from the file once per iteration. For every edge the program's
+// Scatter() may emit updates addressed to vertices, and these are shuffled into one buffer per
+// partition of the vertices. Once the whole file has been streamed each partition's updates are
+// handed to Gather(), partitions in parallel. A program looks like:
+//
+//     class Program {
+//     public:
+//         typedef ... Update;  // trivially copyable
+//         template <typename Emit>
+//         void Scatter(VertexId from, VertexId to, Emit& emit);  // emit(target, update)
+//         void Gather(VertexId target, const Update& update);  // only one thread per partition
+//         bool EndIteration();  // true to run another iteration
+//     };
+template <typename V>
+class BasicEdgeStreamEngine
+{
+public:
+    typedef V VertexId;
+
+    BasicEdgeStreamEngine(BasicEdgeFile<VertexId>* edges, StreamOptions options = StreamOptions()) :
+        m_edges(edges),
+        m_options(options) {
+        m_options.m_partition_vertices = std::max<std::size_t>(m_options.m_partition_vertices, 1);
+        m_options.m_buffered_updates = std::max<std::size_t>(m_options.m_buffered_updates, 1);
+    }
+
+    // Runs iterations until the program asks to stop or max_iterations have run, and returns the
+    // number of iterations.
+    template <typename Program>
+    std::size_t Run(Program& program, std::size_t max_iterations) {
+        typedef typename Program::Update Update;
+
+        class Record {
+        public:
+            VertexId m_target;
+            Update m_update;
+        };
+
+        class Partition {
+        public:
+            std::vector<Record> m_buffer;
+            FileHandle m_spill;
+            std::size_t m_spilled = 0;
+        };
+
+        const std::size_t partition_vertices = m_options.m_partition_vertices;
+        const std::size_t vertex_count = m_edges->GetVertexCount();
+        std::vector<Partition> partitions((vertex_count + partition_vertices - 1) / partition_vertices);
+
+        auto spill = [] (Partition& partition) {
+            if (!partition.m_spill) {
+                partition.m_spill.reset(std::tmpfile());
+                if (!partition.m_spill) {
+                    throw std::system_error(errno, std::generic_category(), "tmpfile");
+                }
+            }
+            if (partition.m_spilled == 0 && std::fseek(partition.m_spill.get(), 0, SEEK_SET) != 0) {
+                throw std::system_error(errno, std::generic_category(), "rewind updates");
+            }
+
+            const std::size_t count = partition.m_buffer.size();
+            if (std::fwrite(partition.m_buffer.data(), sizeof(Record), count, partition.m_spill.get()) != count) {
+                throw std::system_error(errno, std::generic_category(), "write updates");
+            }
+            partition.m_spilled += count;
+            partition.m_buffer.clear();
+        };
+
+        auto emit = [&] (VertexId target, const Update& update) {
+            auto& partition = partitions[static_cast<std::size_t>(target) / partition_vertices];
+            partition.m_buffer.push_back(Record { target, update });
+            if (partition.m_buffer.size() >= m_options.m_buffered_updates) {
+                spill(partition);
+            }
+        };
+
+        auto gather = [&] (Partition& partition) {
+            if (partition.m_spilled > 0) {
+                std::vector<Record> block(std::min(partition.m_spilled, m_options.m_buffered_updates));
+                if (std::fflush(partition.m_spill.get()) != 0 || std::fseek(partition.m_spill.get(), 0, SEEK_SET) != 0) {
+                    throw std::system_error(errno, std::generic_category(), "rewind updates");
+                }
+                for (std::size_t remaining = partition.m_spilled; remaining > 0;) {
+                    const std::size_t count = std::min(block.size(), remaining);
+                    if (std::fread(block.data(), sizeof(Record), count, partition.m_spill.get()) != count) {
+                        throw std::runtime_error("update file is shorter than expected");
+                    }
+                    for (std::size_t i = 0; i < count; i++) {
+                        program.Gather(block[i].m_target, block[i].m_update);
+                    }
+                    remaining -= count;
+                }
+                partition.m_spilled = 0;
+            }
+
+            for (const auto& record : partition.m_buffer) {
+                program.Gather(record.m_target, record.m_update);
+            }
+            partition.m_buffer.clear();
+        };
+
+        std::size_t iteration = 0;
+        while (iteration < max_iterations) {
+            iteration++;
+
+            m_edges->ForEachBlock(m_options.m_block_edges, [&] (const BasicStreamEdge<VertexId>* edges, std::size_t count) {
+                for (std::size_t i = 0; i < count; i++) {
+                    program.Scatter(edges[i].m_from, edges[i].m_to, emit);
+                }
+            });
+
+            parallel_for(partitions.size(), m_options.m_thread_count, [&] (std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    gather(partitions[i]);
+                }
+            });
+
+            if (!program.EndIteration()) {
+                break;
+            }
+        }
+
+        return iteration;
+    }
+
+private:
+
+    BasicEdgeFile<VertexId>* m_edges;
+    StreamOptions m_options;
+};
+
+// Each iteration advances the BFS by one level.
+template <typename VertexId>
+class StreamBfsProgram
+{
+public:
+    typedef unsigned char Update;
+
+    StreamBfsProgram(std::size_t vertex_count, VertexId start_vertex) : m_depths(vertex_count, -1), m_level(0) {
+        m_depths[start_vertex] = 0;
+    }
+
+    template <typename Emit>
+    void Scatter(VertexId from, VertexId to, Emit& emit) {
+        if (m_depths[from] == m_level && m_depths[to] < 0) {
+            emit(to, 0);
+        }
+    }
+
+    void Gather(VertexId target, const Update&) {
+        if (m_depths[target] < 0) {
+            m_depths[target] = m_level + 1;
+            m_discovered.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    bool EndIteration() {
+        m_level++;
+        return m_discovered.exchange(false, std::memory_order_relaxed);
+    }
+
+    std::vector<int> m_depths;
+
+private:
+
+    int m_level;
+    std::atomic<bool> m_discovered { false };
+};
+
+// Minimum-label propagation, treating every edge as undirected.
+template <typename VertexId>
+class StreamComponentsProgram
+{
+public:
+    typedef VertexId Update;
+
+    StreamComponentsProgram(std::size_t vertex_count) : m_labels(vertex_count) {
+        std::iota(m_labels.begin(), m_labels.end(), 0);
+    }
+
+    template <typename Emit>
+    void Scatter(VertexId from, VertexId to, Emit& emit) {
+        if (m_labels[from] < m_labels[to]) {
+            emit(to, m_labels[from]);
+        } else if (m_labels[to] < m_labels[from]) {
+            emit(from, m_labels[to]);
+        }
+    }
+
+    void Gather(VertexId target, const Update& label) {
+        if (label < m_labels[target]) {
+            m_labels[target] = label;
+            m_changed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    bool EndIteration() {
+        return m_changed.exchange(false, std::memory_order_relaxed);
+    }
+
+    std::vector<VertexId> m_labels;
+
+private:
+
+    std::atomic<bool> m_changed { false };
+};
+
+template <typename VertexId>
+class StreamPageRankProgram
+{
+public:
+    typedef double Update;
+
+    StreamPageRankProgram(std::vector<std::size_t> out_degrees, double damping, double tolerance) :
+        m_ranks(out_degrees.size(), 1.0 / out_degrees.size()),
+        m_next(out_degrees.size(), 0),
+        m_out_degrees(std::move(out_degrees)),
+        m_damping(damping),
+        m_tolerance(tolerance) {
+    }
+
+    template <typename Emit>
+    void Scatter(VertexId from, VertexId to, Emit& emit) {
+        emit(to, m_ranks[from] / m_out_degrees[from]);
+    }
+
+    void Gather(VertexId target, const Update& share) {
+        m_next[target] += share;
+    }
+
+    bool EndIteration() {
+        // rank held by vertices without out-edges is spread evenly over all of them
+        const double vertex_count = static_cast<double>(m_ranks.size());
+        double dangling = 0;
+        for (std::size_t vertex = 0; vertex < m_ranks.size(); vertex++) {
+            if (m_out_degrees[vertex] == 0) {
+                dangling += m_ranks[vertex];
+            }
+        }
+
+        double change = 0;
+        for (std::size_t vertex = 0; vertex < m_ranks.size(); vertex++) {
+            const double rank = (1 - m_damping) / vertex_count + m_damping * (m_next[vertex] + dangling / vertex_count);
+            change += std::abs(rank - m_ranks[vertex]);
+            m_ranks[vertex] = rank;
+            m_next[vertex] = 0;
+        }
+        return change > m_tolerance;
+    }
+
+    std::vector<double> m_ranks;
+
+private:
+
+    std::vector<double> m_next;
+    std::vector<std::size_t> m_out_degrees;
+    double m_damping;
+    double m_tolerance;
+};
+
+// BFS depth of every vertex from start_vertex, -1 where it can't be reached; one pass over the
+// edge file per level.
+template <typename VertexId>
+std::vector<int> stream_bfs(
+    BasicEdgeFile<VertexId>* edges,
+    VertexId start_vertex,
+    StreamOptions options = StreamOptions()
+) {
+    StreamBfsProgram<VertexId> program(edges->GetVertexCount(), start_vertex);
+    BasicEdgeStreamEngine<VertexId>(edges, options).Run(program, std::numeric_limits<std::size_t>::max());
+    return program.m_depths;
+}
+
+// Labels every vertex with the smallest vertex id in its weakly connected component.
+template <typename VertexId>
+std::vector<VertexId> stream_connected_components(BasicEdgeFile<VertexId>* edges, StreamOptions options = StreamOptions()) {
+    StreamComponentsProgram<VertexId> program(edges->GetVertexCount());
+    BasicEdgeStreamEngine<VertexId>(edges, options).Run(program, std::numeric_limits<std::size_t>::max());
+    return program.m_labels;
+}
+
+// PageRank by power iteration, stopping once the ranks move by less than tolerance in total.
+template <typename VertexId>
+std::vector<double> stream_page_rank(
+    BasicEdgeFile<VertexId>* edges,
+    double damping = 0.85,
+    double tolerance = 1e-9,
+    std::size_t max_iterations = 100,
+    StreamOptions options = StreamOptions()
+) {
+    std::vector<std::size_t> out_degrees(edges->GetVertexCount(), 0);
+    edges->ForEachBlock(options.m_block_edges, [&] (const BasicStreamEdge<VertexId>* block, std::size_t count) {
+        for (std::size_t i = 0; i < count; i++) {
+            out_degrees[block[i].m_from]++;
+        }
+    });
+
+    StreamPageRankProgram<VertexId> program(std::move(out_degrees), damping, tolerance);
+    BasicEdgeStreamEngine<VertexId>(edges, options).Run(program, max_iterations);
+    return program.m_ranks;
+}
+
+template <typename T>
+class GraphTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<AdjacencyListGraph, AdjacencyMatrixGraph, SnapshotGraph> GraphTypes;
+TYPED_TEST_CASE(GraphTest, GraphTypes);
+
+AdjacencyListGraph random_undirected_graph(int vertex_count, int edge_count) {
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> vertex(0, vertex_count - 1);
+
+    AdjacencyListGraph graph(vertex_count);
+    for (int i = 0; i < edge_count; i++) {
+        graph.AddEdge(vertex(generator), vertex(generator), false);
+    }
+    return graph;
+}
+
+TYPED_TEST(GraphTest, TestEmptyGraph) {
+    TypeParam graph(5);
+    
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(graph.GetEdgesForVertex(i).empty());
+    }
+}
+
+TYPED_TEST(GraphTest, TestBasicGraph) {
+    TypeParam graph(5);
+    graph.AddEdge(3, 4, false);
+
+    auto edges3 = graph.GetEdgesForVertex(3);
+    auto edges4 = graph.GetEdgesForVertex(4);
+
+    auto edges3_expected = std::vector<int>({4});
+    auto edges4_expected = std::vector<int>({3});
+
+    EXPECT_EQ(edges3_expected, edges3);
+    EXPECT_EQ(edges4_expected, edges4);
+}
+
+TYPED_TEST(GraphTest, TestRemoveEdge) {
+    TypeParam graph(5);
+    graph.AddEdge(3, 4, false);
+
+    graph.RemoveEdge(4, 3, false);
+
+    auto edges3 = graph.GetEdgesForVertex(3);
+    auto edges4 = graph.GetEdgesForVertex(4);
+
+    EXPECT_TRUE(edges3.empty());
+    EXPECT_TRUE(edges4.empty());
+}
+
+TYPED_TEST(GraphTest, TestAddEdges) {
+    TypeParam graph(5);
+    graph.AddEdges({ { 0, 4 }, { 2, 3 }, { 0, 1 }, { 3, 3 } }, false, false);
+
+    TypeParam expected(5);
+    expected.AddEdge(0, 4, false);
+    expected.AddEdge(2, 3, false);
+    expected.AddEdge(0, 1, false);
+    expected.AddEdge(3, 3, false);
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(expected.GetEdgesForVertex(i), graph.GetEdgesForVertex(i));
+    }
+}
+
+TYPED_TEST(GraphTest, TestAddEdgesDeduplicate) {
+    TypeParam graph(5);
+    graph.AddEdge(0, 4, false);
+    graph.AddEdges({ { 0, 4 }, { 0, 1 }, { 4, 0 }, { 0, 4 } }, false, true);
+
+    EXPECT_EQ(std::vector<int>({ 1, 4 }), graph.GetEdgesForVertex(0));
+    EXPECT_EQ(std::vector<int>({ 0 }), graph.GetEdgesForVertex(1));
+    EXPECT_EQ(std::vector<int>({ 0 }), graph.GetEdgesForVertex(4));
+}
+
+TYPED_TEST(GraphTest, TestCoreNumbers) {
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 0 }, { 3, 0 }, { 4, 5 } }, false, false);
+
+    EXPECT_EQ(std::vector<int>({ 2, 2, 2, 1, 1, 1 }), core_numbers(&graph));
+    EXPECT_EQ(std::vector<int>({ 2, 2, 2, 1, 1, 1 }), core_numbers_parallel(&graph, 2));
+}
+
+TEST(CoreNumbers, ParallelMatchesSequential) {
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> vertex(0, 499);
+
+    AdjacencyListGraph graph(500);
+    for (int i = 0; i < 5000; i++) {
+        const int from = vertex(generator);
+        const int to = vertex(generator);
+        if (from != to) {
+            graph.AddEdge(from, to, false);
+        }
+    }
+
+    const auto expected = core_numbers(&graph);
+    EXPECT_EQ(expected, core_numbers_parallel(&graph, 4));
+    EXPECT_LT(1, *std::max_element(expected.begin(), expected.end()));
+}
+
+TEST(CoreNumbers, ParallelSkipsEmptyDegrees) {
+    // cliques of very different sizes in a sparse random graph, so that many values of k have
+    // no vertices at all and the vertices of a clique wait in high buckets for a long time
+    std::mt19937 generator(12);
+    AdjacencyListGraph graph(20000);
+    int first = 0;
+    for (int size : { 3, 10, 40, 41, 90 }) {
+        for (int i = first; i < first + size; i++) {
+            for (int j = i + 1; j < first + size; j++) {
+                graph.AddEdge(i, j, false);
+            }
+        }
+        first += size;
+    }
+    std::uniform_int_distribution<int> vertex(0, 19999);
+    for (int i = 0; i < 30000; i++) {
+        const int from = vertex(generator);
+        const int to = vertex(generator);
+        if (from != to) {
+            graph.AddEdge(from, to, false);
+        }
+    }
+
+    const auto expected = core_numbers(&graph);
+    EXPECT_EQ(expected, core_numbers_parallel(&graph, 4));
+    EXPECT_LE(89, *std::max_element(expected.begin(), expected.end()));
+}
+
+TYPED_TEST(GraphTest, TestLabelPropagation) {
+    // two 4-cliques joined by a single edge, plus an isolated vertex
+    TypeParam graph(9);
+    for (int first : { 0, 4 }) {
+        for (int i = first; i < first + 4; i++) {
+            for (int j = i + 1; j < first + 4; j++) {
+                graph.AddEdge(i, j, false);
+            }
+        }
+    }
+    graph.AddEdge(3, 4, false);
+
+    const auto labels = label_propagation_communities(&graph, 0, 100, 1);
+    for (int i = 1; i < 4; i++) {
+        EXPECT_EQ(labels[0], labels[i]);
+        EXPECT_EQ(labels[4], labels[4 + i]);
+    }
+    EXPECT_NE(labels[0], labels[4]);
+    EXPECT_EQ(8, labels[8]);
+}
+
+TEST(LabelPropagation, ManyThreads) {
+    // a ring of 20 cliques of 10 vertices each
+    AdjacencyListGraph graph(200);
+    for (int clique = 0; clique < 20; clique++) {
+        const int first = clique * 10;
+        for (int i = first; i < first + 10; i++) {
+            for (int j = i + 1; j < first + 10; j++) {
+                graph.AddEdge(i, j, false);
+            }
+        }
+        graph.AddEdge(first, (first + 19) % 200, false);
+    }
+
+    const auto labels = label_propagation_communities(&graph, 0, 100, 4);
+    for (int vertex = 0; vertex < 200; vertex++) {
+        EXPECT_EQ(labels[vertex / 10 * 10 + 1], labels[vertex]);
+    }
+    // neighbouring cliques may merge, but they can't all collapse into one community
+    EXPECT_LT(1, std::unordered_set<int>(labels.begin(), labels.end()).size());
+}
+
+TYPED_TEST(GraphTest, TestBFSStats) {
+    TypeParam graph(5);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 1, 3 } }, false, false);
+
+    TraversalStats stats;
+    bfs(&graph, [] (int, int) {}, [] (int) {}, 0, stats);
+
+    EXPECT_EQ(6, stats.m_edges_examined);
+    EXPECT_EQ(4, stats.m_vertices_discovered);
+    ASSERT_EQ(3, stats.m_phases.size());
+    EXPECT_EQ(1, stats.m_phases[0].m_frontier_size);
+    EXPECT_EQ(1, stats.m_phases[1].m_frontier_size);
+    EXPECT_EQ(2, stats.m_phases[2].m_frontier_size);
+    EXPECT_EQ(0, stats.m_auxiliary_bytes);
+    EXPECT_LT(5 * sizeof(int), stats.m_peak_auxiliary_bytes);
+}
+
+TYPED_TEST(GraphTest, TestDFSStats) {
+    TypeParam graph(5);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 1, 3 } }, false, false);
+
+    TraversalStats stats;
+    dfs(&graph, [] (int) {}, [] (int, int) {}, 0, stats);
+
+    EXPECT_EQ(6, stats.m_edges_examined);
+    EXPECT_EQ(4, stats.m_vertices_discovered);
+    ASSERT_EQ(1, stats.m_phases.size());
+    EXPECT_EQ(0, stats.m_auxiliary_bytes);
+}
+
+TYPED_TEST(GraphTest, TestConnectedComponentsStats) {
+    TypeParam graph(5);
+    graph.AddEdge(0, 4, false);
+    graph.AddEdge(2, 3, false);
+
+    TraversalStats stats;
+    auto components = connected_components(&graph, stats);
+
+    EXPECT_EQ(3, components.size());
+    EXPECT_EQ(5, stats.m_vertices_discovered);
+    EXPECT_EQ(4, stats.m_edges_examined);
+    EXPECT_EQ(5, stats.m_phases.size());
+    EXPECT_EQ(0, stats.m_auxiliary_bytes);
+}
+
+TYPED_TEST(GraphTest, TestBetweennessCentrality) {
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 4 } }, false, false);
+
+    EXPECT_EQ(std::vector<double>({ 0, 6, 8, 6, 0, 0 }), betweenness_centrality(&graph, 1));
+    EXPECT_EQ(std::vector<double>({ 0, 6, 8, 6, 0, 0 }), approximate_betweenness_centrality(&graph, 6, 1, 1));
+}
+
+TYPED_TEST(GraphTest, TestBfsCursor) {
+    TypeParam graph(7);
+    graph.AddEdges({ { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 4 }, { 4, 5 } }, false, false);
+    typedef typename TypeParam::VertexId VertexId;
+
+    std::vector<VertexId> expected;
+    bfs(&graph, [] (VertexId, VertexId) {}, [&] (VertexId vertex) { expected.push_back(vertex); });
+
+    BfsCursor<TypeParam> cursor(&graph);
+    std::vector<VertexId> order;
+    std::vector<std::size_t> depths;
+    for (const auto& step : cursor) {
+        order.push_back(step.m_vertex);
+        depths.push_back(step.m_depth);
     }
+    EXPECT_EQ(expected, order);
+    EXPECT_EQ(std::vector<std::size_t>({ 0, 1, 1, 2, 2, 3 }), depths);
 
-    std::vector<std::vector<int>> found_components;
-    while (!to_process.empty()) {
-        std::vector<int> current_component;
-        auto process_vertex = [&] (int edge) {
-            to_process.erase(edge);
-            current_component.push_back(edge);
-        };
-        bfs(graph, [] (int, int) {}, process_vertex, *(to_process.begin()));
-        found_components.push_back(current_component);
+    // stop at the first vertex two edges away, then start over from elsewhere
+    cursor.Reset(5);
+    typename BfsCursor<TypeParam>::Step step;
+    while (cursor.Next(step) && step.m_depth < 2) {
     }
+    EXPECT_EQ(VertexId(2), step.m_vertex);
+    EXPECT_EQ(VertexId(4), step.m_parent);
 
-    return found_components;
+    cursor.Reset(6);
+    ASSERT_TRUE(cursor.Next(step));
+    EXPECT_EQ(VertexId(6), step.m_vertex);
+    EXPECT_EQ(null_vertex<VertexId>(), step.m_parent);
+    EXPECT_FALSE(cursor.Next(step));
 }
 
-template <typename T>
-class GraphTest : public ::testing::Test {
+TYPED_TEST(GraphTest, TestDfsCursor) {
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 2 }, { 0, 1 }, { 1, 3 }, { 3, 2 }, { 2, 4 } }, false, false);
+    typedef typename TypeParam::VertexId VertexId;
+
+    // dfs() reports tree edges in preorder of their end vertex
+    std::vector<std::pair<VertexId, VertexId>> expected;
+    std::vector<VertexState> states(6, VertexState::Undiscovered);
+    states[0] = VertexState::Discovered;
+    dfs(&graph, [] (VertexId) {}, [&] (VertexId start, VertexId end) {
+        if (states[end] == VertexState::Undiscovered) {
+            states[end] = VertexState::Discovered;
+            expected.emplace_back(start, end);
+        }
+    });
+
+    DfsCursor<TypeParam> cursor(&graph);
+    std::vector<std::pair<VertexId, VertexId>> tree_edges;
+    for (auto step = cursor.begin(); step != cursor.end(); ++step) {
+        if (step->m_parent != null_vertex<VertexId>()) {
+            tree_edges.emplace_back(step->m_parent, step->m_vertex);
+        }
+    }
+    EXPECT_EQ(expected, tree_edges);
+}
+
+TEST(TraversalCursor, Interleaved) {
+    AdjacencyListGraph graph(4);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 3 } }, true, false);
+
+    BfsCursor<AdjacencyListGraph> forward(&graph, 0);
+    DfsCursor<AdjacencyListGraph> from_middle(&graph, 2);
+    BfsCursor<AdjacencyListGraph>::Step a;
+    DfsCursor<AdjacencyListGraph>::Step b;
+
+    std::vector<int> seen;
+    while (forward.Next(a)) {
+        seen.push_back(a.m_vertex);
+        if (from_middle.Next(b)) {
+            seen.push_back(b.m_vertex);
+        }
+    }
+    EXPECT_EQ(std::vector<int>({ 0, 2, 1, 3, 2, 3 }), seen);
+}
+
+TEST(TraversalCursor, BfsExpandsOnTheNextCall) {
+    class CountingGraph : public AdjacencyListGraph {
+    public:
+        CountingGraph(int vertex_count) : AdjacencyListGraph(vertex_count), m_lookups(0) {
+        }
+
+        virtual std::vector<int> GetEdgesForVertex(int vertex) override {
+            m_lookups++;
+            return AdjacencyListGraph::GetEdgesForVertex(vertex);
+        }
+
+        int m_lookups;
+    };
+
+    CountingGraph graph(4);
+    graph.AddEdges({ { 0, 1 }, { 0, 2 }, { 1, 3 } }, true, false);
+    BfsCursor<CountingGraph> cursor(&graph);
+    BfsCursor<CountingGraph>::Step step;
+
+    // the start vertex comes out before its edges are looked at
+    ASSERT_TRUE(cursor.Next(step));
+    EXPECT_EQ(0, step.m_vertex);
+    EXPECT_EQ(0, graph.m_lookups);
+    ASSERT_TRUE(cursor.Next(step));
+    EXPECT_EQ(1, step.m_vertex);
+    EXPECT_EQ(1, graph.m_lookups);
+
+    while (cursor.Next(step)) {
+    }
+    EXPECT_EQ(4, graph.m_lookups);
+}
+
+TYPED_TEST(GraphTest, TestBiconnectivity) {
+    // triangle 0-1-2, bridge 2-3, triangle 3-4-5, tail 5-6 and an isolated vertex 7
+    TypeParam graph(8);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 0 }, { 2, 3 }, { 3, 4 }, { 4, 5 }, { 5, 3 }, { 5, 6 } }, false, false);
+
+    auto result = biconnectivity(&graph);
+    typedef typename TypeParam::VertexId VertexId;
+    typedef std::pair<VertexId, VertexId> Edge;
+    EXPECT_EQ(std::vector<VertexId>({ 2, 3, 5 }), result.m_articulation_points);
+    EXPECT_EQ(std::vector<Edge>({ { 2, 3 }, { 5, 6 } }), result.m_bridges);
+
+    for (auto& component : result.m_components) {
+        std::sort(component.begin(), component.end());
+    }
+    std::sort(result.m_components.begin(), result.m_components.end());
+    EXPECT_EQ(
+        std::vector<std::vector<VertexId>>({ { 0, 1, 2 }, { 2, 3 }, { 3, 4, 5 }, { 5, 6 } }),
+        result.m_components
+    );
+}
+
+TYPED_TEST(GraphTest, TestSubgraphExtraction) {
+    // path 0-1-2-3-4 plus a chord 1-3
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 4 }, { 1, 3 } }, false, false);
+    typedef typename TypeParam::VertexId VertexId;
+
+    auto induced = induced_subgraph(&graph, { 3, 1, 2, 3 });
+    EXPECT_EQ(std::vector<VertexId>({ 3, 1, 2 }), induced.m_global_ids);
+    BasicCsrGraph<VertexId> induced_graph(induced.m_rows);
+    EXPECT_EQ(3u, induced_graph.GetVertexCount());
+    for (VertexId vertex = 0; vertex < 3; vertex++) {
+        EXPECT_EQ(2u, induced_graph.GetEdgesForVertex(vertex).size());
+    }
+    EXPECT_FALSE(is_bipartite(&induced_graph));
+
+    auto ego = k_hop_subgraph(&graph, { 0 }, 2);
+    EXPECT_EQ(std::vector<VertexId>({ 0, 1, 2, 3 }), ego.m_global_ids);
+    EXPECT_EQ(std::vector<std::size_t>({ 0, 1, 4, 6, 8 }), ego.m_rows.m_offsets);
+
+    EXPECT_EQ(std::vector<VertexId>({ 5 }), k_hop_subgraph(&graph, { 5 }, 3).m_global_ids);
+    EXPECT_EQ(std::vector<VertexId>({ 2 }), k_hop_subgraph(&graph, { 2 }, 0).m_global_ids);
+}
+
+TEST(SubgraphExtraction, ParallelBuildMatchesSerial) {
+    auto graph = random_undirected_graph(20000, 60000);
+    std::vector<int> vertices;
+    for (int vertex = 0; vertex < 20000; vertex += 2) {
+        vertices.push_back(vertex);
+    }
+
+    SubgraphExtractor<AdjacencyListGraph> serial(&graph, 1);
+    SubgraphExtractor<AdjacencyListGraph> parallel(&graph, 4);
+    for (int round = 0; round < 2; round++) {
+        auto expected = serial.Induced(vertices);
+        auto actual = parallel.Induced(vertices);
+        EXPECT_EQ(expected.m_rows.m_offsets, actual.m_rows.m_offsets);
+        EXPECT_EQ(expected.m_rows.m_targets, actual.m_rows.m_targets);
+        EXPECT_EQ(expected.m_global_ids, actual.m_global_ids);
+    }
+
+    // each local edge joins two selected vertices
+    auto subgraph = parallel.KHop({ 0 }, 2);
+    for (std::size_t row = 0; row < subgraph.m_global_ids.size(); row++) {
+        for (auto target = subgraph.m_rows.Begin(row); target != subgraph.m_rows.End(row); target++) {
+            auto edges = graph.GetEdgesForVertex(subgraph.m_global_ids[row]);
+            EXPECT_NE(edges.end(), std::find(edges.begin(), edges.end(), subgraph.m_global_ids[*target]));
+        }
+    }
+}
+
+TEST(MaxFlow, TextbookNetwork) {
+    FlowNetwork network(6);
+    network.AddArc(0, 1, 16);
+    network.AddArc(0, 2, 13);
+    network.AddArc(2, 1, 4);
+    network.AddArc(1, 3, 12);
+    network.AddArc(3, 2, 9);
+    network.AddArc(2, 4, 14);
+    network.AddArc(4, 3, 7);
+    const auto last = network.AddArc(3, 5, 20);
+    network.AddArc(4, 5, 4);
+
+    EXPECT_EQ(23, network.MaxFlow(0, 5));
+    EXPECT_EQ(19, network.GetFlow(last));
+    EXPECT_EQ(std::vector<bool>({ true, true, true, false, true, false }), network.MinCut(0));
+
+    // the sink can't be reached the other way round
+    EXPECT_EQ(0, network.MaxFlow(5, 0));
+    EXPECT_THROW(network.AddArc(0, 5, 1), std::logic_error);
+}
+
+TEST(MaxFlow, ThreadsAgreeAndFlowIsValid) {
+    const int vertex_count = 20000;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> vertex(0, vertex_count - 1);
+    std::uniform_int_distribution<int> capacity(0, 100);
+
+    FlowNetwork serial(vertex_count);
+    FlowNetwork parallel(vertex_count);
+    std::vector<std::tuple<int, int, int>> arcs;
+    for (int i = 0; i < 100000; i++) {
+        arcs.emplace_back(vertex(generator), vertex(generator), capacity(generator));
+        serial.AddArc(std::get<0>(arcs.back()), std::get<1>(arcs.back()), std::get<2>(arcs.back()));
+        parallel.AddArc(std::get<0>(arcs.back()), std::get<1>(arcs.back()), std::get<2>(arcs.back()));
+    }
+
+    const auto value = serial.MaxFlow(0, 1);
+    EXPECT_LT(0, value);
+    EXPECT_EQ(value, parallel.MaxFlow(0, 1, 4));
+
+    // capacities respected, flow conserved, and the cut is as small as the flow
+    const auto cut = parallel.MinCut(0);
+    std::vector<std::int64_t> balance(vertex_count, 0);
+    std::int64_t cut_capacity = 0;
+    for (std::size_t arc = 0; arc < arcs.size(); arc++) {
+        const int from = std::get<0>(arcs[arc]);
+        const int to = std::get<1>(arcs[arc]);
+        const auto flow = parallel.GetFlow(arc);
+        EXPECT_LE(0, flow);
+        EXPECT_GE(std::get<2>(arcs[arc]), flow);
+        balance[from] -= flow;
+        balance[to] += flow;
+        if (cut[from] && !cut[to]) {
+            cut_capacity += std::get<2>(arcs[arc]);
+        }
+    }
+    for (int v = 2; v < vertex_count; v++) {
+        EXPECT_EQ(0, balance[v]);
+    }
+    EXPECT_EQ(value, balance[1]);
+    EXPECT_EQ(value, cut_capacity);
+    EXPECT_TRUE(cut[0]);
+    EXPECT_FALSE(cut[1]);
+}
+
+TEST(MaxFlow, CongestedChains) {
+    // every chain reaches the sink through one narrow arc at its end, so excess backs up and
+    // leaves label after label empty on its way back to the source
+    const int chain_count = 20;
+    const int chain_length = 5000;
+    FlowNetwork network(2 + chain_count * chain_length);
+    for (int chain = 0; chain < chain_count; chain++) {
+        const int first = 2 + chain * chain_length;
+        const int length = chain_length - chain;
+        network.AddArc(0, first, 3);
+        for (int i = 1; i < length; i++) {
+            network.AddArc(first + i - 1, first + i, 3);
+        }
+        network.AddArc(first + length - 1, 1, 1);
+    }
+
+    EXPECT_EQ(chain_count, network.MaxFlow(0, 1));
+    const auto cut = network.MinCut(0);
+    EXPECT_TRUE(cut[2 + chain_length - 1]);
+    EXPECT_FALSE(cut[1]);
+}
+
+// Name of a fresh temporary file, removed again when this goes out of scope.
+class TemporaryPath
+{
+public:
+    TemporaryPath() {
+        char name[] = "/tmp/graph-test-XXXXXX";
+        const int fd = mkstemp(name);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "mkstemp");
+        }
+        close(fd);
+        m_path = name;
+    }
+
+    ~TemporaryPath() {
+        unlink(m_path.c_str());
+    }
+
+    std::string m_path;
 };
 
-typedef ::testing::Types<AdjacencyListGraph, AdjacencyMatrixGraph> GraphTypes;
-TYPED_TEST_CASE(GraphTest, GraphTypes);
+TEST(EdgeStream, EdgeFileRoundTrip) {
+    TemporaryPath path;
+    {
+        EdgeFile file(path.m_path, 4, true);
+        file.Append({ { 0, 1 }, { 1, 2 } });
+        file.Append({ { 2, 3 } });
+        EXPECT_EQ(3u, file.GetEdgeCount());
+    }
 
-TYPED_TEST(GraphTest, TestEmptyGraph) {
-    TypeParam graph(5);
-    
-    for (int i = 0; i < 5; i++) {
-        EXPECT_TRUE(graph.GetEdgesForVertex(i).empty());
+    EdgeFile file(path.m_path, 4, false);
+    EXPECT_EQ(3u, file.GetEdgeCount());
+    std::vector<std::pair<int, int>> edges;
+    std::size_t blocks = 0;
+    file.ForEachBlock(2, [&] (const EdgeFile::Edge* block, std::size_t count) {
+        blocks++;
+        for (std::size_t i = 0; i < count; i++) {
+            edges.emplace_back(block[i].m_from, block[i].m_to);
+        }
+    });
+    EXPECT_EQ(2u, blocks);
+    EXPECT_EQ((std::vector<std::pair<int, int>> { { 0, 1 }, { 1, 2 }, { 2, 3 } }), edges);
+}
+
+TEST(EdgeStream, MatchesInMemoryAlgorithms) {
+    auto graph = random_undirected_graph(5000, 4000);
+    TemporaryPath path;
+    auto file = write_edge_file(&graph, path.m_path);
+
+    // tiny blocks, partitions and buffers so that updates get spilled
+    StreamOptions options;
+    options.m_block_edges = 1000;
+    options.m_partition_vertices = 700;
+    options.m_buffered_updates = 50;
+    options.m_thread_count = 4;
+
+    std::vector<int> expected_depths(5000, -1);
+    expected_depths[0] = 0;
+    bfs(&graph, [&] (int from, int to) {
+        if (expected_depths[to] < 0) {
+            expected_depths[to] = expected_depths[from] + 1;
+        }
+    }, [] (int) {});
+    EXPECT_EQ(expected_depths, stream_bfs(&file, 0, options));
+
+    std::vector<int> expected_labels(5000);
+    for (const auto& component : connected_components(&graph)) {
+        const int label = *std::min_element(component.begin(), component.end());
+        for (auto vertex : component) {
+            expected_labels[vertex] = label;
+        }
     }
+    EXPECT_EQ(expected_labels, stream_connected_components(&file, options));
 }
 
-TYPED_TEST(GraphTest, TestBasicGraph) {
-    TypeParam graph(5);
-    graph.AddEdge(3, 4, false);
+// PageRank by in-memory power iteration over the graph's adjacency lists, to check the streamed one.
+std::vector<double> page_rank_in_memory(AdjacencyListGraph* graph, double damping, std::size_t iterations) {
+    const int vertex_count = graph->GetVertexCount();
+    std::vector<double> ranks(vertex_count, 1.0 / vertex_count);
+    for (std::size_t iteration = 0; iteration < iterations; iteration++) {
+        std::vector<double> next(vertex_count, 0);
+        double dangling = 0;
+        for (int vertex = 0; vertex < vertex_count; vertex++) {
+            const auto targets = graph->GetEdgesForVertex(vertex);
+            if (targets.empty()) {
+                dangling += ranks[vertex];
+            }
+            for (auto target : targets) {
+                next[target] += ranks[vertex] / targets.size();
+            }
+        }
+        for (int vertex = 0; vertex < vertex_count; vertex++) {
+            ranks[vertex] = (1 - damping) / vertex_count + damping * (next[vertex] + dangling / vertex_count);
+        }
+    }
+    return ranks;
+}
 
-    auto edges3 = graph.GetEdgesForVertex(3);
-    auto edges4 = graph.GetEdgesForVertex(4);
+TEST(EdgeStream, PageRank) {
+    // the cycle's vertices share their rank; the isolated vertex 4 only gets the teleport share
+    // and its own rank spread back as a dangling vertex: d = 0.15 / 5 + 0.85 * d / 5
+    AdjacencyListGraph graph(5);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } }, true, false);
+    TemporaryPath path;
+    auto file = write_edge_file(&graph, path.m_path);
+    auto ranks = stream_page_rank(&file);
+    const double dangling = 0.03 / (1 - 0.17);
+    for (int vertex = 0; vertex < 4; vertex++) {
+        EXPECT_NEAR((1 - dangling) / 4, ranks[vertex], 1e-8);
+    }
+    EXPECT_NEAR(dangling, ranks[4], 1e-8);
 
-    auto edges3_expected = std::vector<int>({4});
-    auto edges4_expected = std::vector<int>({3});
+    // random directed graph with dangling vertices, streamed through tiny blocks and buffers
+    std::mt19937 generator(3);
+    AdjacencyListGraph random_graph(2000);
+    for (int i = 0; i < 6000; i++) {
+        const int from = generator() % 1800;
+        const int to = generator() % 2000;
+        if (from != to) {
+            random_graph.AddEdge(from, to, true);
+        }
+    }
+    file = write_edge_file(&random_graph, path.m_path);
 
-    EXPECT_EQ(edges3_expected, edges3);
-    EXPECT_EQ(edges4_expected, edges4);
+    StreamOptions options;
+    options.m_block_edges = 1000;
+    options.m_partition_vertices = 300;
+    options.m_buffered_updates = 50;
+    options.m_thread_count = 4;
+    ranks = stream_page_rank(&file, 0.85, 1e-12, 200, options);
+    const auto expected = page_rank_in_memory(&random_graph, 0.85, 200);
+    ASSERT_EQ(expected.size(), ranks.size());
+    for (std::size_t vertex = 0; vertex < ranks.size(); vertex++) {
+        EXPECT_NEAR(expected[vertex], ranks[vertex], 1e-9);
+    }
+    EXPECT_NEAR(1.0, std::accumulate(ranks.begin(), ranks.end(), 0.0), 1e-6);
 }
 
-TYPED_TEST(GraphTest, TestRemoveEdge) {
-    TypeParam graph(5);
-    graph.AddEdge(3, 4, false);
+TEST(CsrGraph, IsReadOnly) {
+    CsrGraph graph(CompressedSparseRows {});
+    EXPECT_EQ(0, graph.GetVertexCount());
+    EXPECT_THROW(graph.AddEdge(0, 0, false), std::logic_error);
+    EXPECT_THROW(graph.AddEdges({ { 0, 0 } }, false, false), std::logic_error);
+    EXPECT_THROW(graph.RemoveEdge(0, 0, false), std::logic_error);
+}
 
-    graph.RemoveEdge(4, 3, false);
+TEST(Biconnectivity, ParallelEdgesAreNotBridges) {
+    AdjacencyListGraph graph(3);
+    graph.AddEdges({ { 0, 1 }, { 0, 1 }, { 1, 2 } }, false, false);
 
-    auto edges3 = graph.GetEdgesForVertex(3);
-    auto edges4 = graph.GetEdgesForVertex(4);
+    auto result = biconnectivity(&graph);
+    EXPECT_EQ(std::vector<int>({ 1 }), result.m_articulation_points);
+    ASSERT_EQ(1u, result.m_bridges.size());
+    EXPECT_EQ(std::make_pair(1, 2), result.m_bridges[0]);
+    EXPECT_EQ(2u, result.m_components.size());
+}
 
-    EXPECT_TRUE(edges3.empty());
-    EXPECT_TRUE(edges4.empty());
+TEST(Biconnectivity, LongPath) {
+    // deep enough to overflow the stack of a recursive DFS
+    const int vertex_count = 1 << 20;
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i + 1 < vertex_count; i++) {
+        edges.emplace_back(i, i + 1);
+    }
+    AdjacencyListGraph graph(vertex_count);
+    graph.AddEdges(edges, false, false);
+
+    auto result = biconnectivity(&graph);
+    EXPECT_EQ(static_cast<std::size_t>(vertex_count - 2), result.m_articulation_points.size());
+    EXPECT_EQ(static_cast<std::size_t>(vertex_count - 1), result.m_bridges.size());
+    EXPECT_EQ(static_cast<std::size_t>(vertex_count - 1), result.m_components.size());
+
+    // closing the cycle leaves a single component
+    graph.AddEdge(vertex_count - 1, 0, false);
+    result = biconnectivity(&graph);
+    EXPECT_TRUE(result.m_articulation_points.empty());
+    EXPECT_TRUE(result.m_bridges.empty());
+    EXPECT_EQ(1u, result.m_components.size());
+}
+
+TEST(BetweennessCentrality, DirectedGraph) {
+    // two shortest paths from 0 to 3, through 1 and through 2
+    AdjacencyListGraph graph(4);
+    graph.AddEdges({ { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 3 } }, true, false);
+
+    EXPECT_EQ(std::vector<double>({ 0, 0.5, 0.5, 0 }), betweenness_centrality(&graph, 1));
+}
+
+TEST(BetweennessCentrality, ThreadsAndSampling) {
+    auto graph = random_undirected_graph(300, 900);
+
+    const auto expected = betweenness_centrality(&graph, 1);
+    const auto parallel = betweenness_centrality(&graph, 4);
+    for (int i = 0; i < 300; i++) {
+        EXPECT_NEAR(expected[i], parallel[i], 1e-6 * (1 + expected[i]));
+    }
+
+    // the busiest vertex should stand out in a sample too
+    const auto sampled = approximate_betweenness_centrality(&graph, 100, 5, 4);
+    const auto busiest = std::max_element(expected.begin(), expected.end()) - expected.begin();
+    EXPECT_LT(0, sampled[busiest]);
+    EXPECT_LT(std::accumulate(sampled.begin(), sampled.end(), 0.0) / 300, sampled[busiest]);
+}
+
+TEST(AdjacencyListGraph, AddEdgesLargeBatch) {
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> vertex(0, 999);
+
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < 200000; i++) {
+        edges.push_back(std::make_pair(vertex(generator), vertex(generator)));
+    }
+
+    AdjacencyListGraph batched(1000);
+    batched.AddEdges(edges, true, false);
+
+    AdjacencyListGraph expected(1000);
+    for (const auto& edge : edges) {
+        expected.AddEdge(edge.first, edge.second, true);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(expected.GetEdgesForVertex(i), batched.GetEdgesForVertex(i));
+    }
+}
+
+TEST(SnapshotGraph, SnapshotIsImmutable) {
+    SnapshotGraph graph(5);
+    graph.AddEdge(0, 1, false);
+
+    auto before = graph.TakeSnapshot();
+    graph.AddEdge(0, 2, false);
+    graph.RemoveEdge(0, 1, false);
+    auto after = graph.TakeSnapshot();
+
+    EXPECT_EQ(std::vector<int>({ 1 }), before.GetEdgesForVertex(0));
+    EXPECT_EQ(std::vector<int>({ 0 }), before.GetEdgesForVertex(1));
+    EXPECT_TRUE(before.GetEdgesForVertex(2).empty());
+    EXPECT_EQ(std::vector<int>({ 2 }), after.GetEdgesForVertex(0));
+    EXPECT_TRUE(after.GetEdgesForVertex(1).empty());
+    EXPECT_THROW(after.AddEdge(1, 2, false), std::logic_error);
+
+    graph.AddEdge(3, 4, true);
+    auto directed = graph.TakeSnapshot();
+    graph.RemoveEdge(3, 4, true);
+    EXPECT_EQ(std::vector<int>({ 4 }), directed.GetEdgesForVertex(3));
+    EXPECT_TRUE(directed.GetEdgesForVertex(4).empty());
+    EXPECT_TRUE(graph.TakeSnapshot().GetEdgesForVertex(3).empty());
+}
+
+TEST(SnapshotGraph, ConcurrentReaders) {
+    const int vertex_count = 2000;
+    SnapshotGraph graph(vertex_count);
+
+    // the writer grows a path 0-1-2-..., so every consistent snapshot reaches a prefix of it
+    std::atomic<bool> done(false);
+    std::atomic<int> inconsistent(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                auto snapshot = graph.TakeSnapshot();
+                int visited = 0;
+                int largest = 0;
+                bfs(&snapshot, [] (int, int) {}, [&] (int vertex) {
+                    visited++;
+                    largest = std::max(largest, vertex);
+                });
+                if (largest != visited - 1) {
+                    inconsistent++;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i + 1 < vertex_count; i++) {
+        graph.AddEdge(i, i + 1, false);
+    }
+    done.store(true);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, inconsistent.load());
+    EXPECT_EQ(std::vector<int>({ vertex_count - 2 }), graph.GetEdgesForVertex(vertex_count - 1));
 }
 
 TYPED_TEST(GraphTest, TestBFS) {
@@ -341,9 +4328,53 @@ TYPED_TEST(GraphTest, TestConnectedComponents) {
     graph.AddEdge(2, 3, false);
 
     auto components = connected_components(&graph);
-    EXPECT_EQ((std::vector<int> { 4, 0 }), components[0]);
-    EXPECT_EQ((std::vector<int> { 3, 2 }), components[1]);
-    EXPECT_EQ((std::vector<int> { 1 }), components[2]);
+    ASSERT_EQ(3, components.size());
+    EXPECT_EQ((std::vector<int> { 0, 4 }), components[0]);
+    EXPECT_EQ((std::vector<int> { 1 }), components[1]);
+    EXPECT_EQ((std::vector<int> { 2, 3 }), components[2]);
+}
+
+TYPED_TEST(GraphTest, TestTraversalWorkspace) {
+    TypeParam graph(4);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 } }, false, false);
+    typedef typename TypeParam::VertexId VertexId;
+
+    BasicTraversalWorkspace<VertexId> workspace(4);
+    NoTraversalStats stats;
+    std::vector<VertexId> visited;
+    auto process_vertex = [&] (VertexId vertex) { visited.push_back(vertex); };
+
+    bfs(&graph, [] (VertexId, VertexId) {}, process_vertex, 0, workspace, stats);
+    EXPECT_EQ(std::vector<VertexId>({ 0, 1, 2 }), visited);
+    EXPECT_EQ(VertexState::Processed, workspace.GetState(2));
+    EXPECT_EQ(1u, workspace.GetParent(2));
+    EXPECT_EQ(VertexState::Undiscovered, workspace.GetState(3));
+
+    // already seen, so nothing happens until the workspace is cleared
+    bfs(&graph, [] (VertexId, VertexId) {}, process_vertex, 2, workspace, stats);
+    EXPECT_EQ(3u, visited.size());
+
+    workspace.Clear(4);
+    EXPECT_EQ(VertexState::Undiscovered, workspace.GetState(2));
+    EXPECT_EQ(null_vertex<VertexId>(), workspace.GetParent(2));
+    visited.clear();
+    dfs(&graph, process_vertex, [] (VertexId, VertexId) {}, 2, workspace, stats);
+    EXPECT_EQ(std::vector<VertexId>({ 0, 1, 2 }), visited);
+}
+
+TEST(TraversalWorkspace, ManyClears) {
+    AdjacencyListGraph graph(3);
+    graph.AddEdge(0, 1, false);
+
+    TraversalWorkspace workspace;
+    NoTraversalStats stats;
+    for (int i = 0; i < 1000; i++) {
+        workspace.Clear(3);
+        int visited = 0;
+        bfs(&graph, [] (int, int) {}, [&] (int) { visited++; }, i % 2, workspace, stats);
+        EXPECT_EQ(2, visited);
+        EXPECT_EQ(VertexState::Undiscovered, workspace.GetState(2));
+    }
 }
 
 TYPED_TEST(GraphTest, TestBipartite) {
@@ -383,4 +4414,204 @@ TYPED_TEST(GraphTest, TestDFS) {
     EXPECT_EQ(std::make_pair(0, 3), edges[0]);
     EXPECT_EQ(std::make_pair(3, 4), edges[1]);
     EXPECT_EQ(std::make_pair(4, 0), edges[2]);
-}
\ No newline at end of file
+}
+
+double total_weight(const std::vector<WeightedEdge>& edges) {
+    double total = 0;
+    for (const auto& edge : edges) {
+        total += edge.m_weight;
+    }
+    return total;
+}
+
+std::vector<WeightedEdge> random_weighted_edges(int vertex_count, int edge_count) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> vertex(0, vertex_count - 1);
+    std::uniform_int_distribution<int> weight(1, 100);
+
+    std::vector<WeightedEdge> edges;
+    for (int i = 0; i < edge_count; i++) {
+        edges.push_back(WeightedEdge(vertex(generator), vertex(generator), weight(generator)));
+    }
+    return edges;
+}
+
+TEST(MinimumSpanningForest, Boruvka) {
+    std::vector<WeightedEdge> edges = {
+        { 0, 1, 2 }, { 0, 3, 6 }, { 1, 2, 3 }, { 1, 3, 8 }, { 1, 4, 5 }, { 2, 4, 7 }, { 3, 4, 9 }
+    };
+
+    auto forest = minimum_spanning_forest_boruvka(5, edges, 2);
+    EXPECT_EQ(4, forest.size());
+    EXPECT_EQ(16, total_weight(forest));
+}
+
+TEST(MinimumSpanningForest, FilterKruskal) {
+    std::vector<WeightedEdge> edges = {
+        { 0, 1, 2 }, { 0, 3, 6 }, { 1, 2, 3 }, { 1, 3, 8 }, { 1, 4, 5 }, { 2, 4, 7 }, { 3, 4, 9 }
+    };
+
+    auto forest = minimum_spanning_forest_filter_kruskal(5, edges, 2);
+    EXPECT_EQ(4, forest.size());
+    EXPECT_EQ(16, total_weight(forest));
+}
+
+TEST(MinimumSpanningForest, DisconnectedGraph) {
+    std::vector<WeightedEdge> edges = { { 0, 1, 1 }, { 1, 2, 1 }, { 0, 2, 1 }, { 3, 4, 2 }, { 4, 4, 0 } };
+
+    EXPECT_EQ(3, minimum_spanning_forest_boruvka(6, edges, 2).size());
+    EXPECT_EQ(3, minimum_spanning_forest_filter_kruskal(6, edges, 2).size());
+}
+
+TEST(MinimumSpanningForest, AlgorithmsAgree) {
+    auto edges = random_weighted_edges(2000, 20000);
+
+    auto boruvka = minimum_spanning_forest_boruvka(2000, edges, 4);
+    auto filter_kruskal = minimum_spanning_forest_filter_kruskal(2000, edges, 4);
+    EXPECT_EQ(boruvka.size(), filter_kruskal.size());
+    EXPECT_EQ(total_weight(boruvka), total_weight(filter_kruskal));
+}
+
+template <typename T>
+class TransportTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<SharedMemoryTransport, UnixSocketTransport> TransportTypes;
+TYPED_TEST_CASE(TransportTest, TransportTypes);
+
+TYPED_TEST(TransportTest, TestExchange) {
+    TypeParam transport(3);
+
+    // large enough messages to fill up a socket buffer
+    std::vector<std::vector<std::vector<int>>> received(3);
+    run_workers(3, [&] (int worker) {
+        std::vector<std::vector<int>> outgoing(3);
+        for (int to = 0; to < 3; to++) {
+            outgoing[to].assign(100000 * to, worker);
+        }
+        received[worker] = transport.Exchange(worker, outgoing);
+    });
+
+    for (int worker = 0; worker < 3; worker++) {
+        for (int from = 0; from < 3; from++) {
+            EXPECT_EQ(std::vector<int>(100000 * worker, from), received[worker][from]);
+        }
+    }
+}
+
+TYPED_TEST(TransportTest, TestPartitionedBFS) {
+    auto graph = random_undirected_graph(1000, 900);
+
+    std::vector<int> expected(1000, -1);
+    expected[0] = 0;
+    bfs(&graph, [&] (int from, int to) {
+        if (expected[to] == -1) {
+            expected[to] = expected[from] + 1;
+        }
+    }, [] (int) {});
+
+    PartitionedGraph partitioned(&graph, 4);
+    TypeParam transport(4);
+    EXPECT_EQ(expected, partitioned_bfs(partitioned, transport));
+}
+
+TYPED_TEST(TransportTest, TestPartitionedConnectedComponents) {
+    auto graph = random_undirected_graph(1000, 700);
+
+    std::vector<int> expected(1000);
+    for (const auto& component : connected_components(&graph)) {
+        const int label = *std::min_element(component.begin(), component.end());
+        for (auto vertex : component) {
+            expected[vertex] = label;
+        }
+    }
+
+    PartitionedGraph partitioned(&graph, 3);
+    TypeParam transport(3);
+    EXPECT_EQ(expected, partitioned_connected_components(partitioned, transport));
+}
+
+template <typename T>
+class VertexIdTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<
+    BasicAdjacencyListGraph<std::uint16_t>,
+    BasicAdjacencyListGraph<std::uint32_t>,
+    BasicAdjacencyListGraph<std::uint64_t>,
+    BasicAdjacencyMatrixGraph<std::uint32_t>,
+    BasicSnapshotGraph<std::uint64_t>
+> VertexIdGraphTypes;
+TYPED_TEST_CASE(VertexIdTest, VertexIdGraphTypes);
+
+TYPED_TEST(VertexIdTest, TestTraversals) {
+    typedef typename TypeParam::VertexId VertexId;
+
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 3, 4 } }, false, false);
+
+    std::vector<VertexId> visited;
+    bfs(&graph, [] (VertexId, VertexId) {}, [&] (VertexId vertex) { visited.push_back(vertex); });
+    EXPECT_EQ(std::vector<VertexId>({ 0, 1, 2 }), visited);
+
+    visited.clear();
+    dfs(&graph, [&] (VertexId vertex) { visited.push_back(vertex); }, [] (VertexId, VertexId) {});
+    EXPECT_EQ(std::vector<VertexId>({ 2, 1, 0 }), visited);
+
+    EXPECT_EQ(3, connected_components(&graph).size());
+    EXPECT_TRUE(is_bipartite(&graph));
+}
+
+TYPED_TEST(VertexIdTest, TestAlgorithms) {
+    typedef typename TypeParam::VertexId VertexId;
+
+    TypeParam graph(6);
+    graph.AddEdges({ { 0, 1 }, { 1, 2 }, { 2, 0 }, { 3, 4 } }, false, false);
+
+    EXPECT_EQ(std::vector<int>({ 2, 2, 2, 1, 1, 0 }), core_numbers(&graph));
+    EXPECT_EQ(std::vector<int>({ 2, 2, 2, 1, 1, 0 }), core_numbers_parallel(&graph, 2));
+
+    const auto labels = label_propagation_communities(&graph, 0, 100, 1);
+    EXPECT_EQ(labels[0], labels[1]);
+    EXPECT_EQ(labels[0], labels[2]);
+    EXPECT_EQ(labels[3], labels[4]);
+    EXPECT_EQ(VertexId(5), labels[5]);
+
+    BasicPartitionedGraph<VertexId> partitioned(&graph, 2);
+    BasicUnixSocketTransport<VertexId> transport(2);
+    EXPECT_EQ(std::vector<int>({ 0, 1, 1, -1, -1, -1 }), partitioned_bfs(partitioned, transport));
+    EXPECT_EQ(std::vector<VertexId>({ 0, 0, 0, 3, 3, 5 }), partitioned_connected_components(partitioned, transport));
+}
+
+TEST(VertexId, SixteenBitIdsUpToTheLimit) {
+    // the largest 16 bit id is reserved for "no vertex"
+    BasicAdjacencyListGraph<std::uint16_t> graph(65535);
+    graph.AddEdge(65533, 65534, false);
+
+    std::vector<std::uint16_t> visited;
+    bfs(&graph, [] (std::uint16_t, std::uint16_t) {}, [&] (std::uint16_t vertex) { visited.push_back(vertex); }, 65533);
+    EXPECT_EQ(std::vector<std::uint16_t>({ 65533, 65534 }), visited);
+    EXPECT_EQ(65534, connected_components(&graph).size());
+
+    // two workers own ids up to 65533 and 65534, the last steps before the ids would wrap
+    BasicPartitionedGraph<std::uint16_t> partitioned(&graph, 2);
+    BasicUnixSocketTransport<std::uint16_t> transport(2);
+    const auto distances = partitioned_bfs(partitioned, transport, 65533);
+    EXPECT_EQ(0, distances[65533]);
+    EXPECT_EQ(1, distances[65534]);
+    EXPECT_EQ(-1, distances[0]);
+    const auto labels = partitioned_connected_components(partitioned, transport);
+    EXPECT_EQ(65533, labels[65534]);
+    EXPECT_EQ(1, labels[1]);
+}
+
+TEST(VertexId, MinimumSpanningForestWithWideIds) {
+    std::vector<BasicWeightedEdge<std::uint64_t>> edges = {
+        { 0, 1, 2 }, { 0, 3, 6 }, { 1, 2, 3 }, { 1, 3, 8 }, { 1, 4, 5 }, { 2, 4, 7 }, { 3, 4, 9 }
+    };
+
+    auto boruvka = minimum_spanning_forest_boruvka(5, edges, 2);
+    auto filter_kruskal = minimum_spanning_forest_filter_kruskal(5, edges, 2);
+    EXPECT_EQ(4, boruvka.size());
+    EXPECT_EQ(4, filter_kruskal.size());
+}
@@ -2,85 +2,261 @@
 #include <queue>
 #include <stack>
 #include <algorithm>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "../sortingnetwork/sortingnetwork.h"
+#include "../taskpool/taskpool.h"
 #include "gtest/gtest.h"
 
-template <typename T>
-void merge(
-    std::vector<T>& items,
-    int a_index,
-    int a_size,
-    int b_index,
-    int b_size
-) {
-    int dest_index = a_index;
-    
-    std::deque<T> a(items.begin() + a_index, items.begin() + a_index + a_size);
-    std::deque<T> b(items.begin() + b_index, items.begin() + b_index + b_size);
-
-    while (!a.empty() && !b.empty()) {
-        if (a.front() <= b.front()) {
-            items[dest_index] = a.front();
-            a.pop_front();
+// Moves the sorted runs [a, a_end) and [b, b_end) into dest as one sorted run. Equal items keep
+// their order, with those from a first.
+template <typename Iterator, typename OutputIterator>
+OutputIterator merge_moving(Iterator a, Iterator a_end, Iterator b, Iterator b_end, OutputIterator dest) {
+    while (a != a_end && b != b_end) {
+        if (*b < *a) {
+            *dest = std::move(*b);
+            b++;
         } else {
-            items[dest_index] = b.front();
-            b.pop_front();
+            *dest = std::move(*a);
+            a++;
         }
-
-        dest_index++;
+        dest++;
     }
 
-    while (!a.empty()) {
-        items[dest_index] = a.front();
-        a.pop_front();
-        dest_index++;
+    dest = std::move(a, a_end, dest);
+    return std::move(b, b_end, dest);
+}
+
+// Number of items from a among the first diagonal items of the stable merge of a and b, found by
+// binary search along that diagonal of the merge path.
+template <typename Iterator>
+std::size_t merge_path_split(Iterator a, std::size_t a_size, Iterator b, std::size_t b_size, std::size_t diagonal) {
+    std::size_t low = diagonal > b_size ? diagonal - b_size : 0;
+    std::size_t high = std::min(diagonal, a_size);
+    while (low < high) {
+        const std::size_t middle = low + (high - low) / 2;
+        if (*(b + (diagonal - middle - 1)) < *(a + middle)) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
     }
+    return low;
+}
 
-    while (!b.empty()) {
-        items[dest_index] = b.front();
-        b.pop_front();
-        dest_index++;
+// Cuts the merge of a and b into segment_count pieces of equal output size with
+// merge_path_split() and calls merge(a, a_end, b, b_end, dest) for each piece on pool.
+template <typename Iterator, typename OutputIterator, typename Merge>
+void merge_path_segments(
+    Iterator a, Iterator a_end,
+    Iterator b, Iterator b_end,
+    OutputIterator dest,
+    TaskPool& pool,
+    std::size_t segment_count,
+    const Merge& merge
+) {
+    const std::size_t a_size = a_end - a;
+    const std::size_t b_size = b_end - b;
+    const std::size_t total = a_size + b_size;
+    segment_count = std::max<std::size_t>(1, std::min(segment_count, total));
+
+    pool.ParallelFor(0, segment_count, 1, [&] (std::size_t first, std::size_t last) {
+        for (std::size_t segment = first; segment < last; segment++) {
+            const std::size_t begin = total * segment / segment_count;
+            const std::size_t end = total * (segment + 1) / segment_count;
+            const std::size_t a_begin = merge_path_split(a, a_size, b, b_size, begin);
+            const std::size_t a_stop = merge_path_split(a, a_size, b, b_size, end);
+            merge(a + a_begin, a + a_stop, b + (begin - a_begin), b + (end - a_stop), dest + begin);
+        }
+    });
+}
+
+// Like std::merge, but split into equal pieces that are merged in parallel. Equal items keep their
+// order, with those from a first. By default the merge is cut into one piece per pool thread.
+template <typename Iterator, typename OutputIterator>
+void parallel_merge(
+    Iterator a, Iterator a_end,
+    Iterator b, Iterator b_end,
+    OutputIterator dest,
+    TaskPool& pool = default_task_pool(),
+    std::size_t segment_count = 0
+) {
+    if (segment_count == 0) {
+        segment_count = pool.GetThreadCount();
     }
+
+    merge_path_segments(a, a_end, b, b_end, dest, pool, segment_count,
+        [] (Iterator a_begin, Iterator a_stop, Iterator b_begin, Iterator b_stop, OutputIterator out) {
+            std::merge(a_begin, a_stop, b_begin, b_stop, out);
+        }
+    );
 }
 
+// Mergesort that allocates a single scratch buffer up front instead of one per merge. Levels of
+// the sort alternate between the items and the buffer, so every merge moves each element once and
+// nothing has to be copied back afterwards. The buffer is kept between calls.
 template <typename T>
-void mergesort(std::vector<T>& items, int start_index, int items_to_sort) {
-    if (items_to_sort <= 1) {
-        return;
+class MergeSortEngine
+{
+public:
+    MergeSortEngine(std::size_t capacity = 0) : m_buffer(capacity) {
     }
 
-    const int first_chunk_size = items_to_sort / 2;
-    const int second_chunk_size = items_to_sort - first_chunk_size;
-    const int b_index = start_index + first_chunk_size;
-    mergesort(items, start_index, first_chunk_size);
-    mergesort(items, b_index, second_chunk_size);
+    // Top-down: sorts items_to_sort items starting at start_index.
+    void Sort(std::vector<T>& items, std::size_t start_index, std::size_t items_to_sort) {
+        Reserve(items_to_sort);
+        SortInPlace(items.begin() + start_index, m_buffer.begin(), items_to_sort);
+    }
 
-    merge(items, start_index, first_chunk_size, b_index, second_chunk_size);
-}
+    // Bottom-up: merges runs of 1, 2, 4, ... items, each pass moving everything to the other array.
+    void SortBottomUp(std::vector<T>& items) {
+        const std::size_t count = items.size();
+        Reserve(count);
 
-template <typename T>
-void mergesort_no_recursion(std::vector<T>& items_to_sort) {
-    typedef std::pair<int, int> Range;
+        // runs of the base case size start out sorted
+        std::size_t step = 1;
+        if (UsesSortingNetwork()) {
+            for (std::size_t start = 0; start < count; start += sorting_network_max_size) {
+                sorting_network_sort(&items[start], std::min(sorting_network_max_size, count - start));
+            }
+            step = sorting_network_max_size;
+        }
+
+        auto source = items.begin();
+        auto dest = m_buffer.begin();
+        bool in_buffer = false;
+        for (; step < count; step *= 2) {
+            for (std::size_t left_start = 0; left_start < count; left_start += 2 * step) {
+                // the last block may have no right half, in which case it just moves across
+                const std::size_t left_end = std::min(left_start + step, count);
+                const std::size_t right_end = std::min(left_start + 2 * step, count);
+                merge_moving(
+                    source + left_start, source + left_end,
+                    source + left_end, source + right_end,
+                    dest + left_start
+                );
+            }
+
+            std::swap(source, dest);
+            in_buffer = !in_buffer;
+        }
+
+        if (in_buffer) {
+            std::move(m_buffer.begin(), m_buffer.begin() + count, items.begin());
+        }
+    }
+
+    // Top-down on a task pool: both halves of every range longer than grain are sorted as
+    // separate tasks, and so are both halves of the merges above that size.
+    void ParallelSort(std::vector<T>& items, TaskPool& pool, std::size_t grain) {
+        Reserve(items.size());
+        ParallelSortInPlace(items.begin(), m_buffer.begin(), items.size(), pool, std::max<std::size_t>(grain, 2));
+    }
+
+private:
+
+    typedef typename std::vector<T>::iterator Iterator;
+
+    void ParallelSortInPlace(Iterator items, Iterator scratch, std::size_t count, TaskPool& pool, std::size_t grain) {
+        if (count <= grain) {
+            SortInPlace(items, scratch, count);
+            return;
+        }
+
+        const std::size_t half = count / 2;
+        pool.Invoke(
+            [&] { ParallelSortInto(items, scratch, half, pool, grain); },
+            [&] { ParallelSortInto(items + half, scratch + half, count - half, pool, grain); }
+        );
+        ParallelMerge(scratch, scratch + half, scratch + half, scratch + count, items, pool, grain);
+    }
+
+    void ParallelSortInto(Iterator items, Iterator scratch, std::size_t count, TaskPool& pool, std::size_t grain) {
+        if (count <= grain) {
+            SortInto(items, scratch, count);
+            return;
+        }
 
-    auto Length = [] (Range r) { return r.second - r.first + 1; };
+        const std::size_t half = count / 2;
+        pool.Invoke(
+            [&] { ParallelSortInPlace(items, scratch, half, pool, grain); },
+            [&] { ParallelSortInPlace(items + half, scratch + half, count - half, pool, grain); }
+        );
+        ParallelMerge(items, items + half, items + half, items + count, scratch, pool, grain);
+    }
 
-    for (int step = 1; step <= items_to_sort.size(); step *= 2) {
-        for (int block = 0; block * step * 2 < items_to_sort.size(); block++) {
-            int left_start = block * step * 2;
-            int left_end = (left_start + step) - 1;
-            if (left_end >= items_to_sort.size() - 1) {
-                // No right block, so we can't merge here
-                continue;
+    // Merge-path merge with a piece for every grain items, up to one per thread. Merges high up
+    // the tree run one at a time, so they get every thread; lower ones already run side by side.
+    void ParallelMerge(Iterator a, Iterator a_end, Iterator b, Iterator b_end, Iterator dest, TaskPool& pool, std::size_t grain) {
+        const std::size_t total = (a_end - a) + (b_end - b);
+        const std::size_t segment_count = std::min<std::size_t>(pool.GetThreadCount(), (total + grain - 1) / grain);
+        merge_path_segments(a, a_end, b, b_end, dest, pool, segment_count,
+            [] (Iterator a_begin, Iterator a_stop, Iterator b_begin, Iterator b_stop, Iterator out) {
+                merge_moving(a_begin, a_stop, b_begin, b_stop, out);
             }
+        );
+    }
 
-            int right_start = left_end + 1;
-            int right_end = (right_start + step) - 1;
-            right_end = std::min(right_end, int(items_to_sort.size() - 1));
+    void Reserve(std::size_t count) {
+        if (m_buffer.size() < count) {
+            m_buffer.resize(count);
+        }
+    }
 
-            Range left_range(left_start, left_end);
-            Range right_range(right_start, right_end);
-            merge(items_to_sort, left_range.first, Length(left_range), right_range.first, Length(right_range));
+    // Short ranges of integers are sorted by a sorting network. The network isn't stable, but equal
+    // integers can't be told apart; floats can, as -0.0 and +0.0, so they are still merged.
+    static bool UsesSortingNetwork() {
+        return std::is_integral<T>::value && is_sorting_network_type<T>::value;
+    }
+
+    static bool SortSmall(Iterator items, std::size_t count) {
+        return UsesSortingNetwork() && count <= sorting_network_max_size && sorting_network_sort(&*items, count);
+    }
+
+    // Sorts [items, items + count), using scratch as the buffer.
+    void SortInPlace(Iterator items, Iterator scratch, std::size_t count) {
+        if (count <= 1 || SortSmall(items, count)) {
+            return;
+        }
+
+        const std::size_t half = count / 2;
+        SortInto(items, scratch, half);
+        SortInto(items + half, scratch + half, count - half);
+        merge_moving(scratch, scratch + half, scratch + half, scratch + count, items);
+    }
+
+    // Moves [items, items + count) into scratch in sorted order.
+    void SortInto(Iterator items, Iterator scratch, std::size_t count) {
+        if (count == 1 || SortSmall(items, count)) {
+            std::move(items, items + count, scratch);
+            return;
         }
+
+        const std::size_t half = count / 2;
+        SortInPlace(items, scratch, half);
+        SortInPlace(items + half, scratch + half, count - half);
+        merge_moving(items, items + half, items + half, items + count, scratch);
+    }
+
+    std::vector<T> m_buffer;
+};
+
+template <typename T>
+void mergesort(std::vector<T>& items, int start_index, int items_to_sort) {
+    if (items_to_sort <= 1) {
+        return;
     }
+
+    MergeSortEngine<T> engine(items_to_sort);
+    engine.Sort(items, start_index, items_to_sort);
+}
+
+template <typename T>
+void mergesort_no_recursion(std::vector<T>& items_to_sort) {
+    MergeSortEngine<T> engine(items_to_sort.size());
+    engine.SortBottomUp(items_to_sort);
 }
 
 template <typename T>
@@ -88,6 +264,29 @@ void mergesort(std::vector<T>& items_to_sort) {
     mergesort(items_to_sort, 0, items_to_sort.size());
 }
 
+// Stable like mergesort(), using every thread of pool. Ranges of up to grain items are sorted
+// sequentially.
+template <typename T>
+void parallel_mergesort(std::vector<T>& items_to_sort, TaskPool& pool = default_task_pool(), std::size_t grain = 1 << 14) {
+    MergeSortEngine<T> engine(items_to_sort.size());
+    engine.ParallelSort(items_to_sort, pool, grain);
+}
+
+// Compares on the key only, so the values show whether a sort kept equal keys in order.
+class Item {
+public:
+    bool operator<(const Item& other) const {
+        return m_key < other.m_key;
+    }
+
+    bool operator==(const Item& other) const {
+        return m_key == other.m_key && m_value == other.m_value;
+    }
+
+    int m_key;
+    int m_value;
+};
+
 TEST(MergeSort, CheckEmpty) {
     std::vector<int> items = { };
     mergesort(items);
@@ -159,3 +358,154 @@ TEST(MergeSortNoRecursion, AnotherTest) {
     EXPECT_EQ(5, items[4]);
     EXPECT_EQ(6, items[5]);
 }
+
+TEST(MergeSortEngine, MatchesStdStableSort) {
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> key(0, 50);
+    MergeSortEngine<Item> engine;
+    for (int count : { 0, 1, 2, 3, 7, 100, 1000, 1025 }) {
+        std::vector<Item> items;
+        for (int i = 0; i < count; i++) {
+            items.push_back(Item { key(generator), i });
+        }
+        auto expected = items;
+        std::stable_sort(expected.begin(), expected.end());
+
+        auto top_down = items;
+        engine.Sort(top_down, 0, top_down.size());
+        EXPECT_EQ(expected, top_down);
+
+        auto bottom_up = items;
+        engine.SortBottomUp(bottom_up);
+        EXPECT_EQ(expected, bottom_up);
+    }
+}
+
+TEST(MergeSortEngine, SortsPartOfTheItems) {
+    std::vector<int> items = { 9, 8, 7, 6, 5, 4, 3 };
+    mergesort(items, 2, 4);
+    EXPECT_EQ(std::vector<int>({ 9, 8, 4, 5, 6, 7, 3 }), items);
+}
+
+TEST(MergeSortEngine, MoveOnlyItems) {
+    class MoveOnlyItem {
+    public:
+        MoveOnlyItem() = default;
+        MoveOnlyItem(int value) : m_value(new int(value)) {
+        }
+
+        bool operator<(const MoveOnlyItem& other) const {
+            return *m_value < *other.m_value;
+        }
+
+        std::unique_ptr<int> m_value;
+    };
+
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<MoveOnlyItem> items;
+        for (int value : { 3, 1, 2, 5, 4 }) {
+            items.emplace_back(value);
+        }
+
+        MergeSortEngine<MoveOnlyItem> engine;
+        if (pass == 0) {
+            engine.Sort(items, 0, items.size());
+        } else {
+            engine.SortBottomUp(items);
+        }
+
+        for (int i = 0; i < 5; i++) {
+            EXPECT_EQ(i + 1, *items[i].m_value);
+        }
+    }
+}
+
+TEST(MergeSortEngine, SortingNetworkBaseCase) {
+    // 64 bit integers take the network base case, unsigned ones don't
+    std::mt19937_64 generator(2);
+    MergeSortEngine<std::int64_t> engine;
+    MergeSortEngine<std::uint64_t> unsigned_engine;
+    for (int count : { 5, 63, 64, 65, 129, 1000 }) {
+        std::vector<std::int64_t> items(count);
+        for (auto& item : items) {
+            item = static_cast<std::int64_t>(generator() % 200) - 100;
+        }
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+
+        auto top_down = items;
+        engine.Sort(top_down, 0, top_down.size());
+        EXPECT_EQ(expected, top_down);
+
+        auto bottom_up = items;
+        engine.SortBottomUp(bottom_up);
+        EXPECT_EQ(expected, bottom_up);
+
+        std::vector<std::uint64_t> unsigned_items(items.begin(), items.end());
+        std::vector<std::uint64_t> unsigned_expected(unsigned_items);
+        std::sort(unsigned_expected.begin(), unsigned_expected.end());
+        unsigned_engine.SortBottomUp(unsigned_items);
+        EXPECT_EQ(unsigned_expected, unsigned_items);
+    }
+}
+
+TEST(ParallelMergeSort, MatchesStdStableSort) {
+    std::mt19937 generator(2);
+    std::uniform_int_distribution<int> key(0, 1000);
+    TaskPool pool(4);
+
+    for (int count : { 0, 1, 5, 100, 100000, 300001 }) {
+        std::vector<Item> items;
+        for (int i = 0; i < count; i++) {
+            items.push_back(Item { key(generator), i });
+        }
+        auto expected = items;
+        std::stable_sort(expected.begin(), expected.end());
+
+        parallel_mergesort(items, pool, 1000);
+        EXPECT_EQ(expected, items);
+    }
+}
+
+TEST(ParallelMergeSort, DefaultPool) {
+    std::vector<int> items(1 << 20);
+    std::mt19937 generator(3);
+    for (auto& item : items) {
+        item = static_cast<int>(generator());
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    parallel_mergesort(items);
+    EXPECT_EQ(expected, items);
+}
+
+TEST(ParallelMerge, MatchesStdMerge) {
+    // keys collide a lot, and the values tell which input an item came from
+    std::mt19937 generator(4);
+    std::uniform_int_distribution<int> key(0, 20);
+    TaskPool pool(4);
+
+    for (auto sizes : { std::make_pair(0, 0), std::make_pair(0, 10), std::make_pair(7, 0), std::make_pair(3, 1000),
+                        std::make_pair(5000, 5000), std::make_pair(123457, 54321) }) {
+        std::vector<Item> a;
+        std::vector<Item> b;
+        for (int i = 0; i < sizes.first; i++) {
+            a.push_back(Item { key(generator), i });
+        }
+        for (int i = 0; i < sizes.second; i++) {
+            b.push_back(Item { key(generator), sizes.first + i });
+        }
+        std::stable_sort(a.begin(), a.end());
+        std::stable_sort(b.begin(), b.end());
+
+        std::vector<Item> expected(a.size() + b.size());
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), expected.begin());
+
+        for (std::size_t segments : { 0, 1, 3, 64 }) {
+            std::vector<Item> merged(a.size() + b.size());
+            parallel_merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin(), pool, segments);
+            EXPECT_EQ(expected, merged);
+        }
+    }
+}
@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 #include <queue>
+#include <random>
 #include <stack>
+#include <string>
+#include <type_traits>
+#include "../sortingnetwork/sortingnetwork.h"
+#include "../taskpool/taskpool.h"
 #include "gtest/gtest.h"
 
 template <typename T>
@@ -21,15 +28,21 @@ int partition(std::vector<T>& items, int start_index, int length) {
     return larger_index;
 }
 
+// Short ranges of int32, int64 or float go to a sorting network instead of further partitioning.
+template <typename T>
+bool sort_small_range(std::vector<T>& items, int start_index, int length) {
+    return length <= static_cast<int>(sorting_network_max_size) && sorting_network_sort(items.data() + start_index, length);
+}
+
 template <typename T>
 void quicksort(std::vector<T>& items, int start_index, int length) {
-    if (length <= 1) {
+    if (length <= 1 || sort_small_range(items, start_index, length)) {
         return;
     }
 
     int partition_index = partition(items, start_index, length);
     quicksort(items, start_index, partition_index - start_index);
-    quicksort(items, partition_index + 1, length - 1 - partition_index);
+    quicksort(items, partition_index + 1, start_index + length - 1 - partition_index);
 }
 
 template <typename T>
@@ -51,12 +64,15 @@ void quicksort_no_recursion(std::vector<T>& items_to_sort) {
     while (!to_partition.empty()) {
         Range next = to_partition.top();
         to_partition.pop();
+        if (sort_small_range(items_to_sort, next.first, next.second)) {
+            continue;
+        }
 
         int partition_index = partition(items_to_sort, next.first, next.second);
         
-        int larger_length = next.second - 1 - partition_index;
+        int larger_length = next.first + next.second - 1 - partition_index;
         if (larger_length > 1) {
-            to_partition.push(Range(partition_index + 1, next.second - 1 - partition_index));
+            to_partition.push(Range(partition_index + 1, larger_length));
         }
 
         int smaller_length = partition_index - next.first;
@@ -66,6 +82,634 @@ void quicksort_no_recursion(std::vector<T>& items_to_sort) {
     }
 }
 
+// Ranges this short are left to insertion sort by introsort().
+const int insertion_sort_threshold = 16;
+
+template <typename T>
+void insertion_sort(std::vector<T>& items, int start_index, int length) {
+    for (int i = start_index + 1; i < start_index + length; i++) {
+        T item = std::move(items[i]);
+        int j = i;
+        for (; j > start_index && item < items[j - 1]; j--) {
+            items[j] = std::move(items[j - 1]);
+        }
+        items[j] = std::move(item);
+    }
+}
+
+template <typename T>
+void heapsort(std::vector<T>& items, int start_index, int length) {
+    std::make_heap(items.begin() + start_index, items.begin() + start_index + length);
+    std::sort_heap(items.begin() + start_index, items.begin() + start_index + length);
+}
+
+// Orders items[a], items[b] and items[c] so that the median ends up at b.
+template <typename T>
+void sort3(std::vector<T>& items, int a, int b, int c) {
+    if (items[b] < items[a]) {
+        std::swap(items[a], items[b]);
+    }
+    if (items[c] < items[b]) {
+        std::swap(items[b], items[c]);
+        if (items[b] < items[a]) {
+            std::swap(items[a], items[b]);
+        }
+    }
+}
+
+// Moves a good pivot to the start of the range: the median of the first, middle and last items,
+// or for long ranges Tukey's ninther, the median of three such medians.
+template <typename T>
+void choose_pivot(std::vector<T>& items, int start_index, int length) {
+    const int middle = start_index + length / 2;
+    const int last = start_index + length - 1;
+    if (length > 128) {
+        const int step = length / 8;
+        sort3(items, start_index, start_index + step, start_index + 2 * step);
+        sort3(items, middle - step, middle, middle + step);
+        sort3(items, last - 2 * step, last - step, last);
+        sort3(items, start_index + step, middle, last - step);
+    } else {
+        sort3(items, start_index, middle, last);
+    }
+    std::swap(items[start_index], items[middle]);
+}
+
+// Hoare partition around the pivot at the start of the range; returns where the pivot ends up.
+// Both scans stop at items equal to the pivot, so runs of equal keys get split evenly.
+template <typename T>
+int partition_hoare(std::vector<T>& items, int start_index, int length) {
+    const int end_index = start_index + length;
+    int i = start_index;
+    int j = end_index;
+    while (true) {
+        do {
+            i++;
+        } while (i < end_index && items[i] < items[start_index]);
+        do {
+            j--;
+        } while (items[start_index] < items[j]);
+
+        if (i >= j) {
+            break;
+        }
+        std::swap(items[i], items[j]);
+    }
+
+    std::swap(items[start_index], items[j]);
+    return j;
+}
+
+template <typename T>
+void introsort_loop(std::vector<T>& items, int start_index, int length, int depth_limit) {
+    while (length > insertion_sort_threshold) {
+        if (depth_limit == 0) {
+            heapsort(items, start_index, length);
+            return;
+        }
+        depth_limit--;
+
+        choose_pivot(items, start_index, length);
+        const int partition_index = partition_hoare(items, start_index, length);
+        const int left_length = partition_index - start_index;
+        const int right_length = start_index + length - 1 - partition_index;
+
+        // recurse into the smaller side and loop on the larger one, so the stack stays O(log n)
+        if (left_length < right_length) {
+            introsort_loop(items, start_index, left_length, depth_limit);
+            start_index = partition_index + 1;
+            length = right_length;
+        } else {
+            introsort_loop(items, partition_index + 1, right_length, depth_limit);
+            length = left_length;
+        }
+    }
+
+    insertion_sort(items, start_index, length);
+}
+
+// Quicksort that can't go quadratic: median-of-3 or ninther pivots, insertion sort for short
+// ranges, and heapsort for any range still being partitioned 2 log n levels down.
+template <typename T>
+void introsort(std::vector<T>& items, int start_index, int length) {
+    int depth_limit = 0;
+    for (int n = length; n > 1; n /= 2) {
+        depth_limit += 2;
+    }
+    introsort_loop(items, start_index, length, depth_limit);
+}
+
+template <typename T>
+void introsort(std::vector<T>& items_to_sort) {
+    introsort(items_to_sort, 0, items_to_sort.size());
+}
+
+// Block partitioning from BlockQuicksort (Edelkamp and Weiss), as used by pdqsort: the outcome of
+// every comparison is written into a buffer of offsets whether or not the item is on the wrong
+// side, so the scanning loops have no data-dependent branches, and the misplaced items are then
+// swapped in batches.
+const int partition_block_size = 64;
+
+// Swaps the items at count pairs of offsets from left_base and right_base. When the two blocks
+// hold the same number of misplaced items, plain swaps keep reverse-sorted input reversing
+// cleanly; otherwise a cyclic permutation needs fewer moves.
+template <typename T>
+void swap_offsets(
+    std::vector<T>& items,
+    int left_base,
+    int right_base,
+    const unsigned char* left_offsets,
+    const unsigned char* right_offsets,
+    int count,
+    bool use_swaps
+) {
+    if (use_swaps) {
+        for (int i = 0; i < count; i++) {
+            std::swap(items[left_base + left_offsets[i]], items[right_base - right_offsets[i]]);
+        }
+    } else if (count > 0) {
+        int left = left_base + left_offsets[0];
+        int right = right_base - right_offsets[0];
+        T item = std::move(items[left]);
+        items[left] = std::move(items[right]);
+        for (int i = 1; i < count; i++) {
+            left = left_base + left_offsets[i];
+            items[right] = std::move(items[left]);
+            right = right_base - right_offsets[i];
+            items[left] = std::move(items[right]);
+        }
+        items[right] = std::move(item);
+    }
+}
+
+// Partitions around the pivot at the start of the range, with items equal to the pivot going
+// right. Expects an item no smaller than the pivot near the end of the range, as the pivot
+// choices leave there. Returns where the pivot ends up and whether the range was already
+// partitioned.
+template <typename T, bool Branchless>
+std::pair<int, bool> partition_right(std::vector<T>& items, int start_index, int length) {
+    const int end_index = start_index + length;
+    T pivot = std::move(items[start_index]);
+    int first = start_index;
+    int last = end_index;
+
+    // the first items that need to change sides
+    while (items[++first] < pivot) {
+    }
+    if (first - 1 == start_index) {
+        while (first < last && !(items[--last] < pivot)) {
+        }
+    } else {
+        while (!(items[--last] < pivot)) {
+        }
+    }
+
+    const bool already_partitioned = first >= last;
+    if (!already_partitioned) {
+        std::swap(items[first], items[last]);
+        first++;
+    }
+
+    if (Branchless && !already_partitioned) {
+        alignas(64) unsigned char left_offsets[partition_block_size];
+        alignas(64) unsigned char right_offsets[partition_block_size];
+        int left_base = first;
+        int right_base = last;
+        int left_count = 0;
+        int right_count = 0;
+        int left_start = 0;
+        int right_start = 0;
+
+        while (first < last) {
+            // refill whichever blocks are empty, splitting what's left between them
+            const int unknown = last - first;
+            const int left_split = left_count == 0 ? (right_count == 0 ? unknown / 2 : unknown) : 0;
+            const int right_split = right_count == 0 ? unknown - left_split : 0;
+
+            const int left_scan = std::min(left_split, partition_block_size);
+            for (int i = 0; i < left_scan; i++) {
+                left_offsets[left_count] = static_cast<unsigned char>(i);
+                left_count += !(items[first] < pivot);
+                first++;
+            }
+
+            const int right_scan = std::min(right_split, partition_block_size);
+            for (int i = 0; i < right_scan; i++) {
+                right_offsets[right_count] = static_cast<unsigned char>(i + 1);
+                right_count += items[--last] < pivot;
+            }
+
+            const int count = std::min(left_count, right_count);
+            swap_offsets(
+                items, left_base, right_base,
+                left_offsets + left_start, right_offsets + right_start,
+                count, left_count == right_count
+            );
+            left_count -= count;
+            right_count -= count;
+            left_start += count;
+            right_start += count;
+
+            if (left_count == 0) {
+                left_start = 0;
+                left_base = first;
+            }
+            if (right_count == 0) {
+                right_start = 0;
+                right_base = last;
+            }
+        }
+
+        // one side may still have misplaced items; they go to the far end of the other side
+        if (left_count > 0) {
+            while (left_count-- > 0) {
+                std::swap(items[left_base + left_offsets[left_start + left_count]], items[--last]);
+            }
+            first = last;
+        }
+        if (right_count > 0) {
+            while (right_count-- > 0) {
+                std::swap(items[right_base - right_offsets[right_start + right_count]], items[first]);
+                first++;
+            }
+        }
+    } else if (!already_partitioned) {
+        while (first < last) {
+            while (items[first] < pivot) {
+                first++;
+            }
+            while (!(items[--last] < pivot)) {
+            }
+            if (first < last) {
+                std::swap(items[first], items[last]);
+                first++;
+            }
+        }
+    }
+
+    const int pivot_index = first - 1;
+    items[start_index] = std::move(items[pivot_index]);
+    items[pivot_index] = std::move(pivot);
+    return std::make_pair(pivot_index, already_partitioned);
+}
+
+// Partitions around the pivot at the start of the range with items equal to the pivot going
+// left. pdqsort uses this when the pivot equals the item just before the range, which is then
+// known to be the smallest; everything equal to it ends up in place in one linear pass.
+template <typename T>
+int partition_left(std::vector<T>& items, int start_index, int length) {
+    const int end_index = start_index + length;
+    T pivot = std::move(items[start_index]);
+    int first = start_index;
+    int last = end_index;
+
+    while (pivot < items[--last]) {
+    }
+    if (last + 1 == end_index) {
+        while (first < last && !(pivot < items[++first])) {
+        }
+    } else {
+        while (!(pivot < items[++first])) {
+        }
+    }
+
+    while (first < last) {
+        std::swap(items[first], items[last]);
+        while (pivot < items[--last]) {
+        }
+        while (!(pivot < items[++first])) {
+        }
+    }
+
+    items[start_index] = std::move(items[last]);
+    items[last] = std::move(pivot);
+    return last;
+}
+
+// Insertion sort that gives up once it has moved more than a few items. Returns whether the range
+// ended up sorted.
+template <typename T>
+bool partial_insertion_sort(std::vector<T>& items, int start_index, int length) {
+    const int partial_insertion_sort_limit = 8;
+
+    int moved = 0;
+    for (int i = start_index + 1; i < start_index + length; i++) {
+        if (items[i] < items[i - 1]) {
+            T item = std::move(items[i]);
+            int j = i;
+            for (; j > start_index && item < items[j - 1]; j--) {
+                items[j] = std::move(items[j - 1]);
+            }
+            items[j] = std::move(item);
+            moved += i - j;
+        }
+
+        if (moved > partial_insertion_sort_limit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Swaps a few items around to break up patterns that produced a lopsided partition.
+template <typename T>
+void break_patterns(std::vector<T>& items, int start_index, int length) {
+    if (length < insertion_sort_threshold) {
+        return;
+    }
+
+    const int quarter = length / 4;
+    const int last = start_index + length - 1;
+    std::swap(items[start_index], items[start_index + quarter]);
+    std::swap(items[last], items[last - quarter]);
+    if (length > 128) {
+        std::swap(items[start_index + 1], items[start_index + quarter + 1]);
+        std::swap(items[start_index + 2], items[start_index + quarter + 2]);
+        std::swap(items[last - 1], items[last - quarter - 1]);
+        std::swap(items[last - 2], items[last - quarter - 2]);
+    }
+}
+
+// pdqsort's pivot: the median of the first, middle and last items, or for long ranges the ninther
+// of the first three, middle three and last three. Only the ends and the middle move, which is
+// what lets a reverse-sorted range come out sorted after a single partition.
+template <typename T>
+void choose_pivot_pdqsort(std::vector<T>& items, int start_index, int length) {
+    const int middle = start_index + length / 2;
+    const int last = start_index + length - 1;
+    if (length > 128) {
+        sort3(items, start_index, middle, last);
+        sort3(items, start_index + 1, middle - 1, last - 1);
+        sort3(items, start_index + 2, middle + 1, last - 2);
+        sort3(items, middle - 1, middle, middle + 1);
+        std::swap(items[start_index], items[middle]);
+    } else {
+        sort3(items, middle, start_index, last);
+    }
+}
+
+template <typename T, bool Branchless>
+void pdqsort_loop(std::vector<T>& items, int start_index, int length, int bad_allowed, bool leftmost) {
+    while (length > insertion_sort_threshold) {
+        choose_pivot_pdqsort(items, start_index, length);
+
+        // the item before the range is no bigger than anything in it; if the pivot equals it, so
+        // does everything partition_left() puts on the left, which is then done
+        if (!leftmost && !(items[start_index - 1] < items[start_index])) {
+            const int partition_index = partition_left(items, start_index, length);
+            length -= partition_index + 1 - start_index;
+            start_index = partition_index + 1;
+            continue;
+        }
+
+        const auto partition = partition_right<T, Branchless>(items, start_index, length);
+        const int partition_index = partition.first;
+        const int left_length = partition_index - start_index;
+        const int right_length = start_index + length - 1 - partition_index;
+
+        if (left_length < length / 8 || right_length < length / 8) {
+            if (--bad_allowed == 0) {
+                heapsort(items, start_index, length);
+                return;
+            }
+            break_patterns(items, start_index, left_length);
+            break_patterns(items, partition_index + 1, right_length);
+        } else if (partition.second &&
+                   partial_insertion_sort(items, start_index, left_length) &&
+                   partial_insertion_sort(items, partition_index + 1, right_length)) {
+            // nothing had to move, which suggests the range was already (nearly) sorted
+            return;
+        }
+
+        pdqsort_loop<T, Branchless>(items, start_index, left_length, bad_allowed, leftmost);
+        start_index = partition_index + 1;
+        length = right_length;
+        leftmost = false;
+    }
+
+    insertion_sort(items, start_index, length);
+}
+
+// Pattern-defeating quicksort (Orson Peters): introsort plus linear time on sorted and reverse
+// sorted input and on ranges of equal keys. Arithmetic types use block partitioning by default;
+// for types with expensive comparisons or moves the branchy partition is usually quicker.
+template <typename T, bool Branchless = std::is_arithmetic<T>::value>
+void pdqsort(std::vector<T>& items, int start_index, int length) {
+    int bad_allowed = 1;
+    for (int n = length; n > 1; n /= 2) {
+        bad_allowed++;
+    }
+    pdqsort_loop<T, Branchless>(items, start_index, length, bad_allowed, true);
+}
+
+template <typename T, bool Branchless = std::is_arithmetic<T>::value>
+void pdqsort(std::vector<T>& items_to_sort) {
+    pdqsort<T, Branchless>(items_to_sort, 0, items_to_sort.size());
+}
+
+// Partitions in parallel around the pivot at the start of the range by blocked neutralization
+// (Tsigas and Zhang). Each task claims a block from each end of the range and swaps items between
+// the two until one of them holds only items on its own side, then claims a fresh block for that
+// side. Once the blocks run out, the few blocks left half done are swapped next to the unclaimed
+// middle and that small region is partitioned sequentially. Items equal to the pivot go right,
+// or left with EqualGoLeft, as in partition_left(). Returns where the pivot ends up.
+template <typename T, bool EqualGoLeft = false>
+int parallel_partition(std::vector<T>& items, int start_index, int length, TaskPool& pool, int block_size = 1 << 12) {
+    class Block {
+    public:
+        int m_begin;
+        int m_end;
+    };
+
+    const T pivot = items[start_index];
+    auto goes_left = [&] (const T& item) {
+        return EqualGoLeft ? !(pivot < item) : item < pivot;
+    };
+    int left = start_index + 1;
+    int right = start_index + length;
+    std::mutex mutex;
+    std::vector<int> unfinished_left;
+    std::vector<int> unfinished_right;
+
+    auto claim_left = [&] (Block& block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (right - left < block_size) {
+            return false;
+        }
+        block = Block { left, left + block_size };
+        left += block_size;
+        return true;
+    };
+    auto claim_right = [&] (Block& block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (right - left < block_size) {
+            return false;
+        }
+        block = Block { right - block_size, right };
+        right -= block_size;
+        return true;
+    };
+    auto give_back = [&] (std::vector<int>& unfinished, const Block& block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unfinished.push_back(block.m_begin);
+    };
+
+    pool.ParallelFor(0, pool.GetThreadCount(), 1, [&] (std::size_t, std::size_t) {
+        Block left_block;
+        Block right_block;
+        if (!claim_left(left_block)) {
+            return;
+        }
+        if (!claim_right(right_block)) {
+            give_back(unfinished_left, left_block);
+            return;
+        }
+
+        int i = left_block.m_begin;
+        int j = right_block.m_begin;
+        while (true) {
+            // neutralize: swap until one block is all on its own side
+            while (i < left_block.m_end && j < right_block.m_end) {
+                while (i < left_block.m_end && goes_left(items[i])) {
+                    i++;
+                }
+                while (j < right_block.m_end && !goes_left(items[j])) {
+                    j++;
+                }
+                if (i < left_block.m_end && j < right_block.m_end) {
+                    std::swap(items[i], items[j]);
+                    i++;
+                    j++;
+                }
+            }
+
+            if (i == left_block.m_end) {
+                if (!claim_left(left_block)) {
+                    if (j < right_block.m_end) {
+                        give_back(unfinished_right, right_block);
+                    }
+                    return;
+                }
+                i = left_block.m_begin;
+            }
+            if (j == right_block.m_end) {
+                if (!claim_right(right_block)) {
+                    give_back(unfinished_left, left_block);
+                    return;
+                }
+                j = right_block.m_begin;
+            }
+        }
+    });
+
+    // Move the unfinished blocks next to the middle by swapping them with finished ones there.
+    // The slots are numbered outwards from the middle on each side.
+    auto gather = [&] (std::vector<int>& unfinished, int side) {
+        const int count = static_cast<int>(unfinished.size());
+        auto slot = [&] (int index) {
+            return side < 0 ? left - (index + 1) * block_size : right + index * block_size;
+        };
+        auto in_slots = [&] (int begin) {
+            const int index = side < 0 ? (left - begin) / block_size - 1 : (begin - right) / block_size;
+            return index < count;
+        };
+
+        std::vector<int> free_slots;
+        for (int index = 0; index < count; index++) {
+            if (std::find(unfinished.begin(), unfinished.end(), slot(index)) == unfinished.end()) {
+                free_slots.push_back(slot(index));
+            }
+        }
+        for (auto begin : unfinished) {
+            if (!in_slots(begin)) {
+                std::swap_ranges(items.begin() + begin, items.begin() + begin + block_size, items.begin() + free_slots.back());
+                free_slots.pop_back();
+            }
+        }
+    };
+    gather(unfinished_left, -1);
+    gather(unfinished_right, 1);
+
+    const int region_begin = left - static_cast<int>(unfinished_left.size()) * block_size;
+    const int region_end = right + static_cast<int>(unfinished_right.size()) * block_size;
+    const auto split = std::partition(items.begin() + region_begin, items.begin() + region_end, goes_left);
+
+    const int partition_index = static_cast<int>(split - items.begin()) - 1;
+    std::swap(items[start_index], items[partition_index]);
+    return partition_index;
+}
+
+// Range below which parallel_quicksort() partitions sequentially.
+const int parallel_partition_threshold = 1 << 18;
+
+// The loop of pdqsort_loop() with both sides of each partition sorted as tasks of their own, down
+// to ranges of up to grain items. Lopsided partitions use up the same budget before falling back to
+// heapsort, and runs equal to the item before the range are put in place by one (parallel)
+// partition_left(), so few distinct keys still split into tasks. Returns how many times the range
+// was split into two tasks.
+template <typename T, bool Branchless>
+int parallel_quicksort(std::vector<T>& items, int start_index, int length, TaskPool& pool, int grain, int bad_allowed, bool leftmost) {
+    if (length <= grain) {
+        pdqsort_loop<T, Branchless>(items, start_index, length, bad_allowed, leftmost);
+        return 0;
+    }
+
+    choose_pivot_pdqsort(items, start_index, length);
+    const bool parallel = length >= parallel_partition_threshold;
+
+    if (!leftmost && !(items[start_index - 1] < items[start_index])) {
+        const int partition_index = parallel ?
+            parallel_partition<T, true>(items, start_index, length, pool) :
+            partition_left(items, start_index, length);
+        const int right_length = start_index + length - 1 - partition_index;
+        return parallel_quicksort<T, Branchless>(items, partition_index + 1, right_length, pool, grain, bad_allowed, false);
+    }
+
+    int partition_index;
+    bool already_partitioned = false;
+    if (parallel) {
+        partition_index = parallel_partition(items, start_index, length, pool);
+    } else {
+        const auto partition = partition_right<T, Branchless>(items, start_index, length);
+        partition_index = partition.first;
+        already_partitioned = partition.second;
+    }
+    const int left_length = partition_index - start_index;
+    const int right_length = start_index + length - 1 - partition_index;
+
+    if (left_length < length / 8 || right_length < length / 8) {
+        if (--bad_allowed == 0) {
+            heapsort(items, start_index, length);
+            return 0;
+        }
+        break_patterns(items, start_index, left_length);
+        break_patterns(items, partition_index + 1, right_length);
+    } else if (already_partitioned &&
+               partial_insertion_sort(items, start_index, left_length) &&
+               partial_insertion_sort(items, partition_index + 1, right_length)) {
+        return 0;
+    }
+
+    int left_splits = 0;
+    int right_splits = 0;
+    pool.Invoke(
+        [&] { left_splits = parallel_quicksort<T, Branchless>(items, start_index, left_length, pool, grain, bad_allowed, leftmost); },
+        [&] { right_splits = parallel_quicksort<T, Branchless>(items, partition_index + 1, right_length, pool, grain, bad_allowed, false); }
+    );
+    return 1 + left_splits + right_splits;
+}
+
+// Quicksort on a task pool: both sides of every partition are sorted as separate tasks, large
+// ranges are partitioned by parallel_partition(), and ranges of up to grain items go to pdqsort().
+template <typename T, bool Branchless = std::is_arithmetic<T>::value>
+void parallel_quicksort(std::vector<T>& items_to_sort, TaskPool& pool = default_task_pool(), int grain = 1 << 14) {
+    int bad_allowed = 1;
+    for (int n = static_cast<int>(items_to_sort.size()); n > 1; n /= 2) {
+        bad_allowed++;
+    }
+    parallel_quicksort<T, Branchless>(items_to_sort, 0, items_to_sort.size(), pool, std::max(grain, insertion_sort_threshold), bad_allowed, true);
+}
+
 TEST(QuickSort, CheckEmpty) {
     std::vector<int> items = { };
     quicksort(items);
@@ -136,4 +780,251 @@ TEST(QuickSortNoRecursion, AnotherTest) {
     EXPECT_EQ(4, items[3]);
     EXPECT_EQ(5, items[4]);
     EXPECT_EQ(6, items[5]);
-}
\ No newline at end of file
+}
+
+TEST(QuickSort, RandomItems) {
+    std::mt19937 generator(1);
+    std::vector<int> items(1000);
+    for (auto& item : items) {
+        item = generator() % 100;
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+
+    auto recursive = items;
+    quicksort(recursive);
+    EXPECT_EQ(expected, recursive);
+
+    quicksort_no_recursion(items);
+    EXPECT_EQ(expected, items);
+}
+
+TEST(QuickSort, SortingNetworkBaseCase) {
+    std::mt19937 generator(2);
+    for (int count : { 5, 64, 65, 200 }) {
+        std::vector<float> items(count);
+        for (auto& item : items) {
+            item = static_cast<float>(generator() % 1000) / 8 - 60;
+        }
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+
+        auto recursive = items;
+        quicksort(recursive);
+        EXPECT_EQ(expected, recursive);
+
+        quicksort_no_recursion(items);
+        EXPECT_EQ(expected, items);
+    }
+}
+
+// Inputs that are easy to get wrong or slow: sorted, reversed, all equal, organ pipe, random.
+std::vector<std::vector<int>> awkward_inputs(int count) {
+    std::vector<std::vector<int>> inputs(5, std::vector<int>(count));
+    std::mt19937 generator(count);
+    for (int i = 0; i < count; i++) {
+        inputs[0][i] = i;
+        inputs[1][i] = count - i;
+        inputs[2][i] = 7;
+        inputs[3][i] = std::min(i, count - i);
+        inputs[4][i] = static_cast<int>(generator() % (count + 1));
+    }
+    return inputs;
+}
+
+TEST(IntroSort, MatchesStdSort) {
+    for (int count : { 0, 1, 2, 3, 16, 17, 129, 1000, 10007 }) {
+        for (auto items : awkward_inputs(count)) {
+            auto expected = items;
+            std::sort(expected.begin(), expected.end());
+            introsort(items);
+            EXPECT_EQ(expected, items);
+        }
+    }
+}
+
+TEST(IntroSort, MillionSortedItems) {
+    for (auto items : awkward_inputs(1000000)) {
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+        introsort(items);
+        EXPECT_EQ(expected, items);
+    }
+}
+
+TEST(IntroSort, HeapsortFallback) {
+    // with no depth allowed it's all heapsort, apart from the insertion sort of short ranges
+    std::vector<int> items = awkward_inputs(1000)[4];
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    introsort_loop(items, 0, items.size(), 0);
+    EXPECT_EQ(expected, items);
+
+    std::vector<int> part = { 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    heapsort(part, 2, 5);
+    EXPECT_EQ(std::vector<int>({ 9, 8, 3, 4, 5, 6, 7, 2, 1 }), part);
+}
+
+TEST(PdqSort, MatchesStdSort) {
+    for (int count : { 0, 1, 2, 3, 16, 17, 129, 1000, 10007, 100000 }) {
+        auto inputs = awkward_inputs(count);
+
+        // lots of duplicates, and a sorted run with a few items out of place
+        std::mt19937 generator(count);
+        std::vector<int> duplicates(count);
+        for (auto& item : duplicates) {
+            item = static_cast<int>(generator() % 4);
+        }
+        inputs.push_back(duplicates);
+        if (count > 10) {
+            inputs.push_back(inputs[0]);
+            std::swap(inputs.back()[1], inputs.back()[count - 2]);
+        }
+
+        for (auto items : inputs) {
+            auto expected = items;
+            std::sort(expected.begin(), expected.end());
+
+            auto branchy = items;
+            pdqsort<int, false>(branchy);
+            EXPECT_EQ(expected, branchy);
+
+            pdqsort(items);
+            EXPECT_EQ(expected, items);
+        }
+    }
+}
+
+TEST(PdqSort, Strings) {
+    std::vector<std::string> items;
+    std::mt19937 generator(5);
+    for (int i = 0; i < 5000; i++) {
+        items.push_back(std::to_string(generator() % 1000));
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    pdqsort(items);
+    EXPECT_EQ(expected, items);
+
+    auto forced = expected;
+    std::reverse(forced.begin(), forced.end());
+    pdqsort<std::string, true>(forced);
+    EXPECT_EQ(expected, forced);
+}
+
+// Counts the comparisons a sort makes.
+class CountedInt
+{
+public:
+    bool operator<(const CountedInt& other) const {
+        s_comparisons++;
+        return m_value < other.m_value;
+    }
+
+    int m_value;
+    static long long s_comparisons;
+};
+
+long long CountedInt::s_comparisons = 0;
+
+TEST(PdqSort, LinearOnPatterns) {
+    const int count = 100000;
+    for (int pattern = 0; pattern < 3; pattern++) {
+        std::vector<CountedInt> items(count);
+        for (int i = 0; i < count; i++) {
+            items[i].m_value = pattern == 0 ? i : (pattern == 1 ? count - i : 42);
+        }
+
+        CountedInt::s_comparisons = 0;
+        pdqsort<CountedInt, true>(items);
+        EXPECT_GT(4LL * count, CountedInt::s_comparisons) << "pattern " << pattern;
+        for (int i = 1; i < count; i++) {
+            ASSERT_FALSE(items[i] < items[i - 1]);
+        }
+    }
+}
+
+TEST(ParallelPartition, SmallBlocks) {
+    TaskPool pool(4);
+    for (auto items : awkward_inputs(100000)) {
+        // put a middling pivot first
+        std::swap(items[0], items[items.size() / 3]);
+        const int pivot = items[0];
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+
+        const int partition_index = parallel_partition(items, 0, items.size(), pool, 64);
+        EXPECT_EQ(pivot, items[partition_index]);
+        for (int i = 0; i < partition_index; i++) {
+            ASSERT_LT(items[i], pivot);
+        }
+        for (int i = partition_index + 1; i < static_cast<int>(items.size()); i++) {
+            ASSERT_LE(pivot, items[i]);
+        }
+
+        std::sort(items.begin(), items.end());
+        EXPECT_EQ(expected, items);
+    }
+}
+
+TEST(ParallelPartition, EqualItemsGoLeft) {
+    TaskPool pool(4);
+    for (auto items : awkward_inputs(100000)) {
+        std::swap(items[0], items[items.size() / 3]);
+        const int pivot = items[0];
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+
+        const int partition_index = parallel_partition<int, true>(items, 0, items.size(), pool, 64);
+        EXPECT_EQ(pivot, items[partition_index]);
+        for (int i = 0; i < partition_index; i++) {
+            ASSERT_LE(items[i], pivot);
+        }
+        for (int i = partition_index + 1; i < static_cast<int>(items.size()); i++) {
+            ASSERT_LT(pivot, items[i]);
+        }
+
+        std::sort(items.begin(), items.end());
+        EXPECT_EQ(expected, items);
+    }
+}
+
+TEST(ParallelQuickSort, MatchesStdSort) {
+    TaskPool pool(4);
+    for (int count : { 0, 1, 100, 100000, 1000000 }) {
+        for (auto items : awkward_inputs(count)) {
+            auto expected = items;
+            std::sort(expected.begin(), expected.end());
+            parallel_quicksort(items, pool, 1000);
+            EXPECT_EQ(expected, items);
+        }
+    }
+}
+
+TEST(ParallelQuickSort, SplitsFewDistinctKeys) {
+    // all equal, a thousand distinct keys, and one key making up three quarters of the items;
+    // lopsided partitions and runs of equal keys mustn't leave a big range to one sequential sort
+    const int count = 1 << 20;
+    std::mt19937 generator(6);
+    std::vector<std::vector<int>> inputs(3, std::vector<int>(count, 7));
+    for (int i = 0; i < count; i++) {
+        inputs[1][i] = static_cast<int>(generator() % 1000);
+        if (generator() % 4 == 0) {
+            inputs[2][i] = static_cast<int>(generator());
+        }
+    }
+
+    TaskPool pool(4);
+    const int grain = 1000;
+    const int min_splits[] = { 1, 100, 100 };
+    for (int input = 0; input < 3; input++) {
+        auto& items = inputs[input];
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+        const int splits = parallel_quicksort<int, true>(items, 0, count, pool, grain, 20, true);
+        EXPECT_LE(min_splits[input], splits) << "input " << input;
+        EXPECT_EQ(expected, items);
+    }
+}
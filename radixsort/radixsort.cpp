@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../taskpool/taskpool.h"
+#include "gtest/gtest.h"
+
+// Maps keys to unsigned integers of the same width whose unsigned order is the key order, so that
+// radix sorts can treat every key as a string of digits. Unsigned integers map to themselves,
+// signed integers get their sign bit flipped, and IEEE floats get their sign bit flipped when
+// positive and every bit flipped when negative, which puts -0.0 just before +0.0 and leaves NaNs
+// at the ends.
+template <typename T, typename Enable = void>
+class RadixKey;
+
+template <typename T>
+class RadixKey<T, typename std::enable_if<std::is_integral<T>::value>::type>
+{
+public:
+    typedef typename std::make_unsigned<T>::type Bits;
+
+    static Bits Encode(T key) {
+        const Bits sign = std::is_signed<T>::value ? Bits(Bits(1) << (8 * sizeof(T) - 1)) : Bits(0);
+        return static_cast<Bits>(static_cast<Bits>(key) ^ sign);
+    }
+};
+
+template <typename T>
+class RadixKey<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+public:
+    static_assert(std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8), "only IEEE single and double precision keys are supported");
+    typedef typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type Bits;
+
+    static Bits Encode(T key) {
+        Bits bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        const Bits sign = Bits(1) << (8 * sizeof(T) - 1);
+        const Bits mask = static_cast<Bits>(-static_cast<Bits>(bits >> (8 * sizeof(T) - 1))) | sign;
+        return bits ^ mask;
+    }
+};
+
+// Least significant digit first radix sort. Keys up to 16 bits wide are done in one pass where
+// there are enough of them to pay for the histogram, wider keys in passes of 11 bit digits, whose
+// 2048 counters fit in L1. The histograms of all passes are counted in a single read of the input,
+// and a pass is skipped when every key has the same digit there.
+template <typename T>
+class LsdRadixSorter
+{
+public:
+    typedef typename RadixKey<T>::Bits Bits;
+    static const int key_bits = 8 * sizeof(T);
+
+    LsdRadixSorter() : m_pass_count(0) {
+    }
+
+    void Sort(std::vector<T>& items) {
+        m_pass_count = 0;
+        const std::size_t count = items.size();
+        if (count < 2) {
+            return;
+        }
+
+        const int digit_bits = DigitBits(count);
+        const int pass_count = (key_bits + digit_bits - 1) / digit_bits;
+        const std::size_t bucket_count = std::size_t(1) << digit_bits;
+        const Bits digit_mask = static_cast<Bits>(bucket_count - 1);
+
+        std::vector<std::size_t> histograms(pass_count * bucket_count, 0);
+        for (const T& item : items) {
+            const Bits key = RadixKey<T>::Encode(item);
+            for (int pass = 0; pass < pass_count; pass++) {
+                histograms[pass * bucket_count + ((key >> (pass * digit_bits)) & digit_mask)]++;
+            }
+        }
+
+        m_buffer.resize(count);
+        for (int pass = 0; pass < pass_count; pass++) {
+            std::size_t* histogram = histograms.data() + pass * bucket_count;
+            const int shift = pass * digit_bits;
+            if (histogram[(RadixKey<T>::Encode(items[0]) >> shift) & digit_mask] == count) {
+                continue;
+            }
+
+            // exclusive prefix sum: histogram now holds where each bucket starts
+            std::size_t offset = 0;
+            for (std::size_t bucket = 0; bucket < bucket_count; bucket++) {
+                const std::size_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+
+            Scatter(items, histogram, shift, digit_mask, bucket_count);
+            items.swap(m_buffer);
+            m_pass_count++;
+        }
+    }
+
+    // Number of passes over the items the last Sort() made, not counting the histogram pass.
+    int GetPassCount() const {
+        return m_pass_count;
+    }
+
+private:
+
+    // Items per bucket staged before they are written out: one cache line's worth.
+    static std::size_t StagingSize() {
+        return std::max<std::size_t>(1, 64 / sizeof(T));
+    }
+
+    static int DigitBits(std::size_t count) {
+        if (key_bits == 8) {
+            return 8;
+        }
+        if (key_bits == 16) {
+            return count >= (std::size_t(1) << 16) ? 16 : 8;
+        }
+        return 11;
+    }
+
+    // Moves items into m_buffer ordered by the digit at shift, keeping the order of items with the
+    // same digit. With up to 2048 buckets, items are first collected in a cache line sized staging
+    // slot per bucket and written out a full line at a time, so the writes stream to memory
+    // instead of missing cache and TLB on a different line for nearly every item.
+    void Scatter(const std::vector<T>& items, std::size_t* offsets, int shift, Bits digit_mask, std::size_t bucket_count) {
+        if (bucket_count > 2048) {
+            for (const T& item : items) {
+                m_buffer[offsets[(RadixKey<T>::Encode(item) >> shift) & digit_mask]++] = item;
+            }
+            return;
+        }
+
+        const std::size_t staging_size = StagingSize();
+        m_staging.resize(bucket_count * staging_size);
+        m_staged.assign(bucket_count, 0);
+        T* staging = m_staging.data();
+        std::uint32_t* staged = m_staged.data();
+        T* output = m_buffer.data();
+        for (const T& item : items) {
+            const std::size_t bucket = (RadixKey<T>::Encode(item) >> shift) & digit_mask;
+            T* slot = staging + bucket * staging_size;
+            slot[staged[bucket]] = item;
+            if (++staged[bucket] == staging_size) {
+                std::copy(slot, slot + staging_size, output + offsets[bucket]);
+                offsets[bucket] += staging_size;
+                staged[bucket] = 0;
+            }
+        }
+
+        for (std::size_t bucket = 0; bucket < bucket_count; bucket++) {
+            const T* slot = staging + bucket * staging_size;
+            std::copy(slot, slot + staged[bucket], output + offsets[bucket]);
+        }
+    }
+
+    std::vector<T> m_buffer;
+    std::vector<T> m_staging;
+    std::vector<std::uint32_t> m_staged;
+    int m_pass_count;
+};
+
+template <typename T>
+void radix_sort(std::vector<T>& items_to_sort) {
+    LsdRadixSorter<T>().Sort(items_to_sort);
+}
+
+// Key extractors for ParallelRadixSorter: items that are their own keys, and key-value pairs.
+class SelfKey
+{
+public:
+    template <typename T>
+    const T& operator()(const T& item) const {
+        return item;
+    }
+};
+
+class FirstKey
+{
+public:
+    template <typename K, typename V>
+    const K& operator()(const std::pair<K, V>& item) const {
+        return item.first;
+    }
+};
+
+// Most significant digit first radix sort on a task pool, with 8 bit digits. A large range is cut
+// into one stripe per thread: every stripe counts its own digit histogram, a prefix sum over
+// buckets and then stripes gives each stripe its own place in every bucket, and the stripes scatter
+// into the scratch buffer without any synchronisation. The buckets are then sorted as independent
+// tasks on the next digit, so a skewed distribution just makes some tasks bigger than others, and
+// those use the pool for their own passes again. Equal keys keep their order.
+template <typename Item, typename KeyOf = SelfKey>
+class ParallelRadixSorter
+{
+public:
+    typedef typename std::decay<decltype(std::declval<KeyOf>()(std::declval<const Item&>()))>::type Key;
+    typedef typename RadixKey<Key>::Bits Bits;
+    static const int digit_bits = 8;
+    static const std::size_t radix = std::size_t(1) << digit_bits;
+    static const int key_bits = 8 * sizeof(Key);
+
+    // ranges this short are insertion sorted
+    static const std::size_t insertion_sort_size = 64;
+    // ranges this long are counted and scattered by all threads
+    static const std::size_t parallel_size = 1 << 16;
+
+    ParallelRadixSorter(TaskPool& pool) : m_pool(pool) {
+    }
+
+    void Sort(std::vector<Item>& items) {
+        if (items.size() < 2) {
+            return;
+        }
+        m_buffer.resize(items.size());
+        SortRange(items.data(), m_buffer.data(), true, items.size(), key_bits - digit_bits);
+        m_buffer.clear();
+    }
+
+private:
+    typedef std::array<std::size_t, radix> Histogram;
+
+    static std::size_t Digit(const Item& item, int shift) {
+        return (RadixKey<Key>::Encode(KeyOf()(item)) >> shift) & (radix - 1);
+    }
+
+    // Sorts the count items at from on the digit at shift and all lower ones. to is scratch space
+    // at the same position in the other array; the sorted items end up in the caller's vector,
+    // which is from if from_is_items and to otherwise.
+    void SortRange(Item* from, Item* to, bool from_is_items, std::size_t count, int shift) {
+        if (count <= insertion_sort_size || shift < 0) {
+            if (shift >= 0) {
+                InsertionSort(from, count);
+            }
+            if (!from_is_items) {
+                std::move(from, from + count, to);
+            }
+            return;
+        }
+
+        const std::size_t stripe_count = count >= parallel_size ? static_cast<std::size_t>(m_pool.GetThreadCount()) : 1;
+        const std::size_t stripe_size = (count + stripe_count - 1) / stripe_count;
+        std::vector<Histogram> histograms(stripe_count);
+        m_pool.ParallelFor(0, stripe_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t stripe = first; stripe < last; stripe++) {
+                Histogram& histogram = histograms[stripe];
+                histogram.fill(0);
+                const Item* end = from + std::min(count, (stripe + 1) * stripe_size);
+                for (const Item* item = from + std::min(count, stripe * stripe_size); item != end; item++) {
+                    histogram[Digit(*item, shift)]++;
+                }
+            }
+        });
+
+        // bucket b starts at bucket_begin[b]; within it stripe s writes from histograms[s][b] on
+        std::array<std::size_t, radix + 1> bucket_begin;
+        std::size_t offset = 0;
+        for (std::size_t bucket = 0; bucket < radix; bucket++) {
+            bucket_begin[bucket] = offset;
+            for (auto& histogram : histograms) {
+                const std::size_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+            if (offset - bucket_begin[bucket] == count) {
+                // every key has this digit, so go straight on to the next one
+                SortRange(from, to, from_is_items, count, shift - digit_bits);
+                return;
+            }
+        }
+        bucket_begin[radix] = count;
+
+        m_pool.ParallelFor(0, stripe_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t stripe = first; stripe < last; stripe++) {
+                Histogram& offsets = histograms[stripe];
+                Item* end = from + std::min(count, (stripe + 1) * stripe_size);
+                for (Item* item = from + std::min(count, stripe * stripe_size); item != end; item++) {
+                    to[offsets[Digit(*item, shift)]++] = std::move(*item);
+                }
+            }
+        });
+
+        auto sort_buckets = [&] (std::size_t first, std::size_t last) {
+            for (std::size_t bucket = first; bucket < last; bucket++) {
+                const std::size_t begin = bucket_begin[bucket];
+                SortRange(to + begin, from + begin, !from_is_items, bucket_begin[bucket + 1] - begin, shift - digit_bits);
+            }
+        };
+        if (count >= parallel_size) {
+            m_pool.ParallelFor(0, radix, 1, sort_buckets);
+        } else {
+            sort_buckets(0, radix);
+        }
+    }
+
+    static void InsertionSort(Item* items, std::size_t count) {
+        for (std::size_t i = 1; i < count; i++) {
+            Item item = std::move(items[i]);
+            const Bits key = RadixKey<Key>::Encode(KeyOf()(item));
+            std::size_t j = i;
+            for (; j > 0 && key < RadixKey<Key>::Encode(KeyOf()(items[j - 1])); j--) {
+                items[j] = std::move(items[j - 1]);
+            }
+            items[j] = std::move(item);
+        }
+    }
+
+    TaskPool& m_pool;
+    std::vector<Item> m_buffer;
+};
+
+template <typename T>
+void parallel_radix_sort(std::vector<T>& items_to_sort, TaskPool& pool = default_task_pool()) {
+    ParallelRadixSorter<T>(pool).Sort(items_to_sort);
+}
+
+// Sorts key-value pairs by key only; pairs with equal keys keep their order.
+template <typename K, typename V>
+void parallel_radix_sort_pairs(std::vector<std::pair<K, V>>& items_to_sort, TaskPool& pool = default_task_pool()) {
+    ParallelRadixSorter<std::pair<K, V>, FirstKey>(pool).Sort(items_to_sort);
+}
+
+// Sorts keys and applies the same permutation to values, which must be as long.
+template <typename K, typename V>
+void parallel_radix_sort_by_key(std::vector<K>& keys, std::vector<V>& values, TaskPool& pool = default_task_pool()) {
+    std::vector<std::pair<K, V>> pairs(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        pairs[i] = std::make_pair(keys[i], std::move(values[i]));
+    }
+    parallel_radix_sort_pairs(pairs, pool);
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        keys[i] = pairs[i].first;
+        values[i] = std::move(pairs[i].second);
+    }
+}
+
+template <typename T>
+std::vector<T> random_keys(std::size_t count, std::uint64_t seed) {
+    std::mt19937_64 generator(seed);
+    std::vector<T> keys(count);
+    for (auto& key : keys) {
+        const std::uint64_t bits = generator();
+        std::memcpy(&key, &bits, sizeof(T));
+    }
+    return keys;
+}
+
+template <typename T>
+void expect_sorts_like_std_sort(std::vector<T> items) {
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    radix_sort(items);
+    EXPECT_EQ(expected, items);
+}
+
+TEST(RadixSort, CheckEmpty) {
+    std::vector<int> items = { };
+    radix_sort(items);
+    EXPECT_EQ(0, items.size());
+}
+
+TEST(RadixSort, SortOdd) {
+    std::vector<int> items = { 6, 2, -100, 464, 12 };
+    radix_sort(items);
+    EXPECT_EQ(std::vector<int>({ -100, 2, 6, 12, 464 }), items);
+}
+
+TEST(RadixSort, Integers) {
+    for (std::size_t count : { 1000, 100000 }) {
+        expect_sorts_like_std_sort(random_keys<std::uint8_t>(count, 1));
+        expect_sorts_like_std_sort(random_keys<std::int16_t>(count, 2));
+        expect_sorts_like_std_sort(random_keys<std::uint16_t>(count, 3));
+        expect_sorts_like_std_sort(random_keys<std::int32_t>(count, 4));
+        expect_sorts_like_std_sort(random_keys<std::uint32_t>(count, 5));
+        expect_sorts_like_std_sort(random_keys<std::int64_t>(count, 6));
+        expect_sorts_like_std_sort(random_keys<std::uint64_t>(count, 7));
+    }
+}
+
+TEST(RadixSort, Floats) {
+    std::vector<float> floats = { 1.5f, -0.0f, 0.0f, -1.5f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::denorm_min(), -3e38f };
+    expect_sorts_like_std_sort(floats);
+
+    std::mt19937_64 generator(8);
+    std::normal_distribution<double> normal(0, 1e6);
+    std::vector<double> doubles(100000);
+    for (auto& value : doubles) {
+        value = normal(generator);
+    }
+    expect_sorts_like_std_sort(doubles);
+}
+
+TEST(RadixSort, FloatEncodingKeepsOrder) {
+    EXPECT_LT(RadixKey<float>::Encode(-2.0f), RadixKey<float>::Encode(-1.0f));
+    EXPECT_LT(RadixKey<float>::Encode(-1.0f), RadixKey<float>::Encode(-0.0f));
+    EXPECT_LT(RadixKey<float>::Encode(-0.0f), RadixKey<float>::Encode(0.0f));
+    EXPECT_LT(RadixKey<float>::Encode(0.0f), RadixKey<float>::Encode(1.0f));
+    EXPECT_LT(RadixKey<double>::Encode(1.0), RadixKey<double>::Encode(std::numeric_limits<double>::infinity()));
+}
+
+TEST(RadixSort, SkipsPassesWithOneDigit) {
+    // 64 bit keys below 2048 differ only in the lowest 11 bit digit
+    std::vector<std::uint64_t> items = random_keys<std::uint64_t>(10000, 9);
+    for (auto& item : items) {
+        item %= 2048;
+    }
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+
+    LsdRadixSorter<std::uint64_t> sorter;
+    sorter.Sort(items);
+    EXPECT_EQ(expected, items);
+    EXPECT_EQ(1, sorter.GetPassCount());
+
+    sorter.Sort(items);
+    EXPECT_EQ(expected, items);
+    EXPECT_EQ(1, sorter.GetPassCount());
+
+    std::vector<std::int32_t> negative(1000, -5);
+    LsdRadixSorter<std::int32_t> int_sorter;
+    int_sorter.Sort(negative);
+    EXPECT_EQ(0, int_sorter.GetPassCount());
+}
+
+TEST(ParallelRadixSort, MatchesStdSort) {
+    TaskPool pool(4);
+    for (std::size_t count : { 0, 1, 50, 1000, 300000 }) {
+        auto keys = random_keys<std::uint64_t>(count, 10);
+        auto expected = keys;
+        std::sort(expected.begin(), expected.end());
+        parallel_radix_sort(keys, pool);
+        EXPECT_EQ(expected, keys);
+    }
+
+    auto ints = random_keys<std::int32_t>(200000, 11);
+    auto expected_ints = ints;
+    std::sort(expected_ints.begin(), expected_ints.end());
+    parallel_radix_sort(ints, pool);
+    EXPECT_EQ(expected_ints, ints);
+
+    std::mt19937_64 generator(12);
+    std::normal_distribution<float> normal(0, 1000);
+    std::vector<float> floats(200000);
+    for (auto& value : floats) {
+        value = normal(generator);
+    }
+    auto expected_floats = floats;
+    std::sort(expected_floats.begin(), expected_floats.end());
+    parallel_radix_sort(floats, pool);
+    EXPECT_EQ(expected_floats, floats);
+}
+
+TEST(ParallelRadixSort, Skewed) {
+    // most keys share their top bytes, a few are spread out, and many are repeated
+    TaskPool pool(4);
+    std::mt19937_64 generator(13);
+    std::vector<std::uint64_t> keys(500000);
+    for (auto& key : keys) {
+        const std::uint64_t bits = generator();
+        key = bits % 10 == 0 ? bits : (std::uint64_t(0x1234) << 48) | (bits % 5000);
+    }
+    auto expected = keys;
+    std::sort(expected.begin(), expected.end());
+    parallel_radix_sort(keys, pool);
+    EXPECT_EQ(expected, keys);
+
+    std::vector<std::uint64_t> equal(200000, 42);
+    parallel_radix_sort(equal, pool);
+    EXPECT_EQ(std::vector<std::uint64_t>(200000, 42), equal);
+}
+
+TEST(ParallelRadixSort, PairsAreStable) {
+    TaskPool pool(4);
+    std::mt19937_64 generator(14);
+    std::vector<std::pair<std::int16_t, int>> pairs(200000);
+    for (std::size_t i = 0; i < pairs.size(); i++) {
+        pairs[i] = std::make_pair(static_cast<std::int16_t>(generator() % 1000 - 500), static_cast<int>(i));
+    }
+    auto expected = pairs;
+    std::stable_sort(expected.begin(), expected.end(), [] (const std::pair<std::int16_t, int>& a, const std::pair<std::int16_t, int>& b) {
+        return a.first < b.first;
+    });
+    parallel_radix_sort_pairs(pairs, pool);
+    EXPECT_EQ(expected, pairs);
+}
+
+TEST(ParallelRadixSort, MoveOnlyValues) {
+    // values are moved from buffer to buffer at every level, never copied
+    std::mt19937 generator(15);
+    std::vector<std::pair<std::uint32_t, std::unique_ptr<int>>> pairs;
+    for (int i = 0; i < 100000; i++) {
+        pairs.emplace_back(generator() % 5000, std::unique_ptr<int>(new int(i)));
+    }
+    std::vector<std::pair<std::uint32_t, int>> expected;
+    for (const auto& pair : pairs) {
+        expected.emplace_back(pair.first, *pair.second);
+    }
+    std::stable_sort(expected.begin(), expected.end(), [] (const std::pair<std::uint32_t, int>& a, const std::pair<std::uint32_t, int>& b) {
+        return a.first < b.first;
+    });
+
+    TaskPool pool(4);
+    parallel_radix_sort_pairs(pairs, pool);
+    for (std::size_t i = 0; i < pairs.size(); i++) {
+        ASSERT_EQ(expected[i].first, pairs[i].first);
+        ASSERT_EQ(expected[i].second, *pairs[i].second);
+    }
+}
+
+TEST(ParallelRadixSort, ByKey) {
+    std::vector<std::uint32_t> keys = { 30, 10, 20, 10 };
+    std::vector<std::string> values = { "thirty", "ten", "twenty", "another ten" };
+    parallel_radix_sort_by_key(keys, values);
+    EXPECT_EQ(std::vector<std::uint32_t>({ 10, 10, 20, 30 }), keys);
+    EXPECT_EQ(std::vector<std::string>({ "ten", "another ten", "twenty", "thirty" }), values);
+}
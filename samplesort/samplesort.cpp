@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../taskpool/taskpool.h"
+#include "gtest/gtest.h"
+
+// In-place super scalar samplesort, after IPS4o (Axtmann, Witt, Ferizovic and Sanders). A range is
+// split into up to 256 buckets by splitters drawn from a sample, the buckets are put in order in
+// place, and each bucket is sorted recursively as a task of its own. Every step but taking the
+// sample runs in parallel. Apart from the sample the extra memory is one buffer block per bucket
+// for each stripe being classified and a few more blocks, however large the input.
+template <typename T>
+class SampleSorter
+{
+public:
+    // ranges this short go to std::sort
+    static const std::size_t base_case_size = 2048;
+    static const int max_log_buckets = 8;
+
+    SampleSorter(TaskPool& pool) : m_pool(pool) {
+    }
+
+    void Sort(std::vector<T>& items) {
+        Sort(items, 0, items.size(), 0);
+    }
+
+private:
+
+    // Items per block: 2 KiB worth, as in IPS4o.
+    static std::size_t BlockSize() {
+        return std::max<std::size_t>(1, 2048 / sizeof(T));
+    }
+
+    // Splitters laid out as an implicit binary search tree (root at 1, children of i at 2i and
+    // 2i + 1), so that finding an item's bucket is log k steps of `i = 2i + (tree[i] < item)`
+    // with no branches on the outcome. With repeated splitters every bucket gets a partner bucket
+    // for the items equal to its upper splitter, which needs no further sorting.
+    class Classifier {
+    public:
+        Classifier(std::vector<T> splitters, int log_buckets) :
+            m_log_buckets(log_buckets),
+            m_bucket_count(1 << log_buckets),
+            m_tree(m_bucket_count),
+            m_sorted(std::move(splitters)) {
+            m_equality_buckets = std::adjacent_find(m_sorted.begin(), m_sorted.end()) != m_sorted.end();
+            Build(1, 0, m_sorted.size());
+        }
+
+        int GetBucketCount() const {
+            return m_equality_buckets ? 2 * m_bucket_count : m_bucket_count;
+        }
+
+        bool IsEqualityBucket(int bucket) const {
+            return m_equality_buckets && bucket % 2 == 1;
+        }
+
+        int Classify(const T& item) const {
+            std::size_t node = 1;
+            for (int level = 0; level < m_log_buckets; level++) {
+                node = 2 * node + (m_tree[node] < item);
+            }
+            const int bucket = static_cast<int>(node) - m_bucket_count;
+            if (!m_equality_buckets) {
+                return bucket;
+            }
+            const bool equal = bucket < m_bucket_count - 1 && !(item < m_sorted[bucket]);
+            return 2 * bucket + equal;
+        }
+
+    private:
+
+        // Fills the subtree at node from the sorted splitters in [begin, end).
+        void Build(std::size_t node, std::size_t begin, std::size_t end) {
+            if (node >= m_tree.size()) {
+                return;
+            }
+            const std::size_t middle = begin + (end - begin) / 2;
+            m_tree[node] = m_sorted[middle];
+            Build(2 * node, begin, middle);
+            Build(2 * node + 1, middle + 1, end);
+        }
+
+        int m_log_buckets;
+        int m_bucket_count;
+        std::vector<T> m_tree;
+        std::vector<T> m_sorted;
+        bool m_equality_buckets;
+    };
+
+    // Part of the range classified by one task. Full buffer blocks are written back over the
+    // front of the stripe, which has always been read by then.
+    class Stripe {
+    public:
+        std::size_t m_begin;
+        std::size_t m_end;
+        std::size_t m_written;
+        std::vector<T> m_buffers;
+        std::vector<std::size_t> m_buffer_sizes;
+        std::vector<std::size_t> m_counts;
+    };
+
+    // A bucket's slots during the block permutation: blocks before m_write are in place, blocks
+    // from there up to m_read still have to be looked at, and the slots after that are empty.
+    // The two move together under the lock, as in IPS4o; m_reading counts blocks still being
+    // copied out of slots that already count as empty.
+    class BucketPointers {
+    public:
+        BucketPointers() : m_write(0), m_read(0), m_reading(0) {
+        }
+
+        // Claims the last unprocessed block, if there is one.
+        bool Read(std::size_t& block) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_read <= m_write) {
+                return false;
+            }
+            block = --m_read;
+            m_reading++;
+            return true;
+        }
+
+        // Claims the next slot to write, and says where the unprocessed blocks end.
+        std::size_t Write(std::size_t& read) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            read = m_read;
+            return m_write++;
+        }
+
+        std::size_t m_write;
+        std::size_t m_read;
+        std::atomic<int> m_reading;
+        std::mutex m_mutex;
+    };
+
+    void Sort(std::vector<T>& items, std::size_t begin, std::size_t end, int depth) {
+        const std::size_t count = end - begin;
+        if (count <= base_case_size || depth > 16) {
+            std::sort(items.begin() + begin, items.begin() + end);
+            return;
+        }
+
+        int log_buckets = 1;
+        while (log_buckets < max_log_buckets && (count >> (log_buckets + 1)) >= base_case_size / 2) {
+            log_buckets++;
+        }
+        const Classifier classifier(ChooseSplitters(items, begin, end, log_buckets), log_buckets);
+        const int bucket_count = classifier.GetBucketCount();
+        const std::size_t block_size = BlockSize();
+
+        // classification: each stripe sorts its items into buffer blocks, one per bucket, and
+        // writes each block back to the front of the stripe whenever it fills up
+        const std::size_t stripe_count = std::min<std::size_t>(m_pool.GetThreadCount(), std::max<std::size_t>(1, count / (1 << 16)));
+        const std::size_t stripe_size = ((count + stripe_count - 1) / stripe_count + block_size - 1) / block_size * block_size;
+        std::vector<Stripe> stripes(stripe_count);
+        m_pool.ParallelFor(0, stripe_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t index = first; index < last; index++) {
+                Stripe& stripe = stripes[index];
+                stripe.m_begin = std::min(end, begin + index * stripe_size);
+                stripe.m_end = std::min(end, stripe.m_begin + stripe_size);
+                Classify(items, classifier, stripe, bucket_count, block_size);
+            }
+        });
+
+        // bucket_begin is where each bucket will start; its full blocks go to the block-aligned
+        // slots from block_begin on, which always end before the next bucket's slots start
+        std::vector<std::size_t> bucket_begin(bucket_count + 1, begin);
+        std::vector<std::size_t> block_counts(bucket_count, 0);
+        for (int bucket = 0; bucket < bucket_count; bucket++) {
+            std::size_t size = 0;
+            for (const auto& stripe : stripes) {
+                size += stripe.m_counts[bucket];
+                block_counts[bucket] += (stripe.m_counts[bucket] - stripe.m_buffer_sizes[bucket]) / block_size;
+            }
+            bucket_begin[bucket + 1] = bucket_begin[bucket] + size;
+        }
+        std::vector<std::size_t> block_begin(bucket_count + 1);
+        for (int bucket = 0; bucket <= bucket_count; bucket++) {
+            block_begin[bucket] = (bucket_begin[bucket] - begin + block_size - 1) / block_size;
+        }
+        auto block_at = [&] (std::size_t block) {
+            return items.begin() + begin + block * block_size;
+        };
+
+        // compaction: within each bucket's slots, move the full blocks the stripes wrote there to
+        // the front
+        std::vector<BucketPointers> pointers(bucket_count);
+        auto is_full = [&] (std::size_t block) {
+            return begin + (block + 1) * block_size <= stripes[block * block_size / stripe_size].m_written;
+        };
+        m_pool.ParallelFor(0, bucket_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t bucket = first; bucket < last; bucket++) {
+                std::size_t empty = block_begin[bucket];
+                std::size_t full_end = block_begin[bucket + 1];
+                while (true) {
+                    while (empty < full_end && is_full(empty)) {
+                        empty++;
+                    }
+                    while (empty < full_end && !is_full(full_end - 1)) {
+                        full_end--;
+                    }
+                    if (empty == full_end) {
+                        break;
+                    }
+                    full_end--;
+                    std::move(block_at(full_end), block_at(full_end + 1), block_at(empty));
+                    empty++;
+                }
+                pointers[bucket].m_write = block_begin[bucket];
+                pointers[bucket].m_read = empty;
+            }
+        });
+
+        // block permutation: one task per stripe, each starting on a different bucket; a block
+        // meant for the slot that would stick out past the end goes to the overflow block instead
+        std::vector<T> overflow(block_size);
+        m_pool.ParallelFor(0, stripe_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t index = first; index < last; index++) {
+                Permute(items, begin, end, classifier, pointers, index * bucket_count / stripe_count, overflow);
+            }
+        });
+
+        // cleanup: a bucket's last block can stick out into the buckets after it, so first save
+        // those overhangs, then fill the rest of every bucket from its overhang and the buffers
+        std::vector<T> overhangs(bucket_count * block_size);
+        std::vector<std::size_t> overhang_sizes(bucket_count, 0);
+        m_pool.ParallelFor(0, bucket_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t bucket = first; bucket < last; bucket++) {
+                const std::size_t blocks_end = begin + (block_begin[bucket] + block_counts[bucket]) * block_size;
+                if (block_counts[bucket] == 0 || blocks_end <= bucket_begin[bucket + 1]) {
+                    continue;
+                }
+                auto overhang = items.begin() + bucket_begin[bucket + 1];
+                if (blocks_end > end) {
+                    const std::size_t last_block = blocks_end - block_size;
+                    overhang = overflow.begin() + (bucket_begin[bucket + 1] - last_block);
+                    std::move(overflow.begin(), overhang, items.begin() + last_block);
+                }
+                overhang_sizes[bucket] = blocks_end - bucket_begin[bucket + 1];
+                std::move(overhang, overhang + overhang_sizes[bucket], overhangs.begin() + bucket * block_size);
+            }
+        });
+        m_pool.ParallelFor(0, bucket_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t bucket = first; bucket < last; bucket++) {
+                // the bucket's blocks sit in [blocks_begin, blocks_end), the rest of it is free
+                std::size_t blocks_begin = bucket_begin[bucket + 1];
+                std::size_t blocks_end = blocks_begin;
+                if (block_counts[bucket] > 0) {
+                    blocks_begin = begin + block_begin[bucket] * block_size;
+                    blocks_end = std::min(bucket_begin[bucket + 1], blocks_begin + block_counts[bucket] * block_size);
+                }
+                std::size_t position = bucket_begin[bucket];
+                auto fill = [&] (typename std::vector<T>::iterator source, std::size_t size) {
+                    for (std::size_t i = 0; i < size; i++) {
+                        if (position == blocks_begin) {
+                            position = blocks_end;
+                        }
+                        items[position++] = std::move(source[i]);
+                    }
+                };
+                fill(overhangs.begin() + bucket * block_size, overhang_sizes[bucket]);
+                for (auto& stripe : stripes) {
+                    fill(stripe.m_buffers.begin() + bucket * block_size, stripe.m_buffer_sizes[bucket]);
+                }
+            }
+        });
+
+        // recursion, a task per bucket
+        m_pool.ParallelFor(0, bucket_count, 1, [&] (std::size_t first, std::size_t last) {
+            for (std::size_t bucket = first; bucket < last; bucket++) {
+                if (!classifier.IsEqualityBucket(bucket)) {
+                    Sort(items, bucket_begin[bucket], bucket_begin[bucket + 1], depth + 1);
+                }
+            }
+        });
+    }
+
+    // Sorts a random sample to the front of the range and takes evenly spaced splitters from it.
+    // The sample is about 0.2 log n items per bucket.
+    std::vector<T> ChooseSplitters(std::vector<T>& items, std::size_t begin, std::size_t end, int log_buckets) {
+        const std::size_t count = end - begin;
+        const std::size_t bucket_count = std::size_t(1) << log_buckets;
+        std::size_t log_count = 0;
+        while ((std::size_t(1) << log_count) < count) {
+            log_count++;
+        }
+        const std::size_t oversampling = std::max<std::size_t>(1, log_count / 5);
+        const std::size_t sample_size = std::min(count, oversampling * bucket_count);
+
+        std::mt19937_64 generator(count);
+        for (std::size_t i = 0; i < sample_size; i++) {
+            std::uniform_int_distribution<std::size_t> pick(i, count - 1);
+            std::swap(items[begin + i], items[begin + pick(generator)]);
+        }
+        std::sort(items.begin() + begin, items.begin() + begin + sample_size);
+
+        std::vector<T> splitters;
+        for (std::size_t i = 1; i < bucket_count; i++) {
+            splitters.push_back(items[begin + i * sample_size / bucket_count - (sample_size >= bucket_count ? 1 : 0)]);
+        }
+        return splitters;
+    }
+
+    void Classify(std::vector<T>& items, const Classifier& classifier, Stripe& stripe, int bucket_count, std::size_t block_size) {
+        stripe.m_buffers.resize(bucket_count * block_size);
+        stripe.m_buffer_sizes.assign(bucket_count, 0);
+        stripe.m_counts.assign(bucket_count, 0);
+        stripe.m_written = stripe.m_begin;
+
+        for (std::size_t i = stripe.m_begin; i < stripe.m_end; i++) {
+            const int bucket = classifier.Classify(items[i]);
+            auto& size = stripe.m_buffer_sizes[bucket];
+            auto buffer = stripe.m_buffers.begin() + bucket * block_size;
+            if (size == block_size) {
+                stripe.m_written = std::move(buffer, buffer + block_size, items.begin() + stripe.m_written) - items.begin();
+                size = 0;
+            }
+            buffer[size++] = std::move(items[i]);
+            stripe.m_counts[bucket]++;
+        }
+    }
+
+    // Takes blocks out of the unprocessed slots of each bucket in turn, starting with
+    // first_bucket, and carries each to the next slot of the bucket it belongs to. When that slot
+    // still holds an unprocessed block, the two swap and the other block is carried on.
+    void Permute(std::vector<T>& items, std::size_t begin, std::size_t end, const Classifier& classifier,
+                 std::vector<BucketPointers>& pointers, std::size_t first_bucket, std::vector<T>& overflow) {
+        const std::size_t block_size = BlockSize();
+        const std::size_t bucket_count = pointers.size();
+        auto block_at = [&] (std::size_t block) {
+            return items.begin() + begin + block * block_size;
+        };
+
+        std::vector<T> swap_buffers(2 * block_size);
+        auto carried = swap_buffers.begin();
+        auto swapped = swap_buffers.begin() + block_size;
+        for (std::size_t step = 0; step < bucket_count; step++) {
+            BucketPointers& source = pointers[(first_bucket + step) % bucket_count];
+            std::size_t block;
+            while (source.Read(block)) {
+                std::move(block_at(block), block_at(block + 1), carried);
+                source.m_reading--;
+
+                while (true) {
+                    BucketPointers& target = pointers[classifier.Classify(*carried)];
+                    std::size_t read;
+                    const std::size_t slot = target.Write(read);
+                    if (slot < read) {
+                        std::move(block_at(slot), block_at(slot + 1), swapped);
+                        std::move(carried, carried + block_size, block_at(slot));
+                        std::swap(carried, swapped);
+                        continue;
+                    }
+
+                    // the slot is empty, but may still be being read from
+                    while (target.m_reading.load() != 0) {
+                        std::this_thread::yield();
+                    }
+                    if (begin + (slot + 1) * block_size > end) {
+                        std::move(carried, carried + block_size, overflow.begin());
+                    } else {
+                        std::move(carried, carried + block_size, block_at(slot));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    TaskPool& m_pool;
+};
+
+template <typename T>
+void samplesort(std::vector<T>& items_to_sort, TaskPool& pool = default_task_pool()) {
+    SampleSorter<T>(pool).Sort(items_to_sort);
+}
+
+TEST(SampleSort, CheckEmpty) {
+    std::vector<int> items = { };
+    samplesort(items);
+    EXPECT_EQ(0, items.size());
+}
+
+TEST(SampleSort, SortOdd) {
+    std::vector<int> items = { 6, 2, -100, 464, 12 };
+    samplesort(items);
+    EXPECT_EQ(std::vector<int>({ -100, 2, 6, 12, 464 }), items);
+}
+
+TEST(SampleSort, MatchesStdSort) {
+    // around the base case, with and without a partial last block, and with one stripe, a stripe
+    // per thread, and more threads than stripes
+    std::mt19937_64 generator(1);
+    for (int threads : { 1, 4, 16 }) {
+        TaskPool pool(threads);
+        for (int count : { 2047, 2048, 2049, 6145, 100000, (1 << 20) + 7 }) {
+            std::vector<long long> items(count);
+            for (auto& item : items) {
+                item = static_cast<long long>(generator());
+            }
+            auto expected = items;
+            std::sort(expected.begin(), expected.end());
+
+            auto sorted = expected;
+            samplesort(sorted, pool);
+            EXPECT_EQ(expected, sorted);
+
+            auto reversed = expected;
+            std::reverse(reversed.begin(), reversed.end());
+            samplesort(reversed, pool);
+            EXPECT_EQ(expected, reversed);
+
+            samplesort(items, pool);
+            EXPECT_EQ(expected, items);
+        }
+    }
+}
+
+// A key that counts how often it is moved. Each distribution pass moves an item a handful of
+// times (into a buffer, back as part of a block, maybe swapped along during the permutation, and
+// into its bucket), so moves per item tell how many levels of recursion it went through.
+class MovedKey
+{
+public:
+    MovedKey(int key = 0) : m_key(key) {
+    }
+
+    MovedKey(const MovedKey& other) = default;
+    MovedKey& operator=(const MovedKey& other) = default;
+
+    MovedKey(MovedKey&& other) : m_key(other.m_key) {
+        s_moves++;
+    }
+
+    MovedKey& operator=(MovedKey&& other) {
+        m_key = other.m_key;
+        s_moves++;
+        return *this;
+    }
+
+    bool operator<(const MovedKey& other) const {
+        return m_key < other.m_key;
+    }
+
+    bool operator==(const MovedKey& other) const {
+        return m_key == other.m_key;
+    }
+
+    int m_key;
+    static std::atomic<long long> s_moves;
+};
+
+std::atomic<long long> MovedKey::s_moves(0);
+
+TEST(SampleSort, EqualityBuckets) {
+    // repeated splitters give their keys buckets of their own, which are never sorted further,
+    // so all equal, few distinct and one dominant key go through one or two distribution passes
+    // instead of recursing until the depth limit
+    const int count = 1 << 20;
+    std::mt19937 generator(2);
+    std::vector<std::vector<MovedKey>> inputs(3, std::vector<MovedKey>(count, MovedKey(7)));
+    for (int i = 0; i < count; i++) {
+        inputs[1][i].m_key = static_cast<int>(generator() % 3);
+        if (generator() % 10 == 0) {
+            inputs[2][i].m_key = static_cast<int>(generator());
+        }
+    }
+
+    TaskPool pool(4);
+    const long long max_moves[] = { 5LL * count, 6LL * count, 8LL * count };
+    for (int input = 0; input < 3; input++) {
+        auto& items = inputs[input];
+        auto expected = items;
+        std::sort(expected.begin(), expected.end());
+
+        MovedKey::s_moves = 0;
+        samplesort(items, pool);
+        EXPECT_GT(max_moves[input], MovedKey::s_moves.load()) << "input " << input;
+        EXPECT_EQ(expected, items);
+    }
+}
+
+TEST(SampleSort, SkewedKeys) {
+    // keys spread over many orders of magnitude crowd into the low buckets, which take several
+    // more levels of recursion
+    std::mt19937_64 generator(3);
+    std::vector<unsigned long long> items(1 << 20);
+    for (auto& item : items) {
+        item = generator() >> (generator() % 64);
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    TaskPool pool(4);
+    samplesort(items, pool);
+    EXPECT_EQ(expected, items);
+}
+
+TEST(SampleSort, OneItemBlocks) {
+    // items of 2 KiB or more make blocks of a single item
+    class Large {
+    public:
+        bool operator<(const Large& other) const {
+            return m_key < other.m_key;
+        }
+
+        bool operator==(const Large& other) const {
+            return m_key == other.m_key && m_padding[0] == other.m_padding[0];
+        }
+
+        int m_key;
+        char m_padding[2100];
+    };
+
+    std::mt19937 generator(4);
+    std::vector<Large> items(20000);
+    for (auto& item : items) {
+        item.m_key = static_cast<int>(generator() % 5000);
+        item.m_padding[0] = static_cast<char>(item.m_key);
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    TaskPool pool(4);
+    samplesort(items, pool);
+    EXPECT_EQ(expected, items);
+}
+
+TEST(SampleSort, Strings) {
+    std::vector<std::string> items;
+    std::mt19937 generator(5);
+    for (int i = 0; i < 50000; i++) {
+        items.push_back(std::to_string(generator() % 10000));
+    }
+
+    auto expected = items;
+    std::sort(expected.begin(), expected.end());
+    samplesort(items);
+    EXPECT_EQ(expected, items);
+}
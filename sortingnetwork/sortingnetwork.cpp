@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "sortingnetwork.h"
+#include "gtest/gtest.h"
+
+const SortingNetworkIsa all_isas[] = { SortingNetworkIsa::Scalar, SortingNetworkIsa::Sse4, SortingNetworkIsa::Avx2 };
+
+// Every length from 0 to the largest network, with random items, few distinct items, and items
+// that include the padding value, on every instruction set this host has.
+template <typename T>
+void expect_networks_sort(const std::vector<T>& values) {
+    std::mt19937 generator(1);
+    for (SortingNetworkIsa isa : all_isas) {
+        if (!sorting_network_supports(isa)) {
+            continue;
+        }
+
+        for (std::size_t count = 0; count <= sorting_network_max_size; count++) {
+            for (int round = 0; round < 20; round++) {
+                std::vector<T> items(count);
+                const std::size_t distinct = round % 2 == 0 ? values.size() : 3;
+                for (auto& item : items) {
+                    item = values[generator() % distinct];
+                }
+
+                auto expected = items;
+                std::sort(expected.begin(), expected.end());
+                EXPECT_TRUE(sorting_network_sort(items.data(), count, isa));
+                EXPECT_EQ(expected, items) << "isa " << static_cast<int>(isa) << ", " << count << " items";
+            }
+        }
+    }
+}
+
+TEST(SortingNetwork, Int32) {
+    std::vector<std::int32_t> values = { std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::min(), -1, 0, 1 };
+    std::mt19937 generator(2);
+    for (int i = 0; i < 200; i++) {
+        values.push_back(static_cast<std::int32_t>(generator()));
+    }
+    expect_networks_sort(values);
+}
+
+TEST(SortingNetwork, Int64) {
+    std::vector<std::int64_t> values = { std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min(), -1, 0, 1 };
+    std::mt19937_64 generator(3);
+    for (int i = 0; i < 200; i++) {
+        values.push_back(static_cast<std::int64_t>(generator()));
+    }
+    expect_networks_sort(values);
+}
+
+TEST(SortingNetwork, Float) {
+    std::vector<float> values = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::max(), 0.0f, 1.5f };
+    std::mt19937 generator(4);
+    std::normal_distribution<float> normal(0, 100);
+    for (int i = 0; i < 200; i++) {
+        values.push_back(normal(generator));
+    }
+    expect_networks_sort(values);
+}
+
+TEST(SortingNetwork, DeclinesOtherInputs) {
+    std::vector<std::string> strings = { "b", "a" };
+    EXPECT_FALSE(sorting_network_sort(strings.data(), strings.size()));
+    EXPECT_EQ(std::vector<std::string>({ "b", "a" }), strings);
+
+    std::vector<std::int32_t> long_range(sorting_network_max_size + 1, 0);
+    long_range[0] = 1;
+    EXPECT_FALSE(sorting_network_sort(long_range.data(), long_range.size()));
+    EXPECT_EQ(1, long_range[0]);
+}
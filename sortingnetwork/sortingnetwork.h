@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// Sorting networks for up to 64 int32, int64 or float items, held in SIMD registers. The items are
+// padded to a power of two with the largest value of the type and sorted by a bitonic network in
+// which every comparator is a vector min and max: between registers for strides of a register or
+// more, and within a register, after a shuffle and before a blend, for shorter ones. There are no
+// branches on the data at all. AVX2 or SSE4.2 is picked when the program starts, so one binary
+// runs on any x86-64 host; elsewhere, and on hosts with neither, the same network runs on scalars.
+//
+// Sorting networks are not stable, and for floats that means -0.0 and +0.0 can change places.
+// NaNs are not supported, just as with std::sort.
+
+const std::size_t sorting_network_max_size = 64;
+
+enum class SortingNetworkIsa {
+    Scalar,
+    Sse4,
+    Avx2
+};
+
+// Lane shuffles for vectors of Lanes items: Partner<Mask> moves lane i ^ Mask to lane i, and
+// Blend<Bit> takes the lanes with Bit set from high and the others from low.
+template <int Lanes>
+class NetworkLanes;
+
+template <>
+class NetworkLanes<1>
+{
+public:
+    template <int Mask, typename Vec>
+    static void Partner(Vec& partner, const Vec& v) {
+        partner = v;
+    }
+
+    template <int Bit, typename Vec>
+    static void Blend(Vec& v, const Vec& low, const Vec&) {
+        v = low;
+    }
+};
+
+template <>
+class NetworkLanes<2>
+{
+public:
+    template <int Mask, typename Vec>
+    static void Partner(Vec& partner, const Vec& v) {
+        partner = __builtin_shufflevector(v, v, (0 ^ Mask) & 1, (1 ^ Mask) & 1);
+    }
+
+    template <int Bit, typename Vec>
+    static void Blend(Vec& v, const Vec& low, const Vec& high) {
+        v = __builtin_shufflevector(low, high, (0 & Bit) ? 2 : 0, (1 & Bit) ? 3 : 1);
+    }
+};
+
+template <>
+class NetworkLanes<4>
+{
+public:
+    template <int Mask, typename Vec>
+    static void Partner(Vec& partner, const Vec& v) {
+        partner = __builtin_shufflevector(v, v, (0 ^ Mask) & 3, (1 ^ Mask) & 3, (2 ^ Mask) & 3, (3 ^ Mask) & 3);
+    }
+
+    template <int Bit, typename Vec>
+    static void Blend(Vec& v, const Vec& low, const Vec& high) {
+        v = __builtin_shufflevector(low, high, (0 & Bit) ? 4 : 0, (1 & Bit) ? 5 : 1, (2 & Bit) ? 6 : 2, (3 & Bit) ? 7 : 3);
+    }
+};
+
+template <>
+class NetworkLanes<8>
+{
+public:
+    template <int Mask, typename Vec>
+    static void Partner(Vec& partner, const Vec& v) {
+        partner = __builtin_shufflevector(v, v,
+            (0 ^ Mask) & 7, (1 ^ Mask) & 7, (2 ^ Mask) & 7, (3 ^ Mask) & 7,
+            (4 ^ Mask) & 7, (5 ^ Mask) & 7, (6 ^ Mask) & 7, (7 ^ Mask) & 7);
+    }
+
+    template <int Bit, typename Vec>
+    static void Blend(Vec& v, const Vec& low, const Vec& high) {
+        v = __builtin_shufflevector(low, high,
+            (0 & Bit) ? 8 : 0, (1 & Bit) ? 9 : 1, (2 & Bit) ? 10 : 2, (3 & Bit) ? 11 : 3,
+            (4 & Bit) ? 12 : 4, (5 & Bit) ? 13 : 5, (6 & Bit) ? 14 : 6, (7 & Bit) ? 15 : 7);
+    }
+};
+
+// Bitonic sort of RegisterCount vectors of Lanes items each, in the variant where every
+// comparator puts the smaller item first: each merge compares the first half of a block with the
+// second half reversed, then cleans up both halves at strides of a quarter block down to one.
+// Vec may be a plain scalar with Lanes 1. Everything is inlined into the caller so that it gets
+// compiled for the caller's instruction set.
+template <typename Vec, int Lanes>
+class BitonicNetwork
+{
+public:
+    template <int RegisterCount>
+    __attribute__((always_inline)) static void Sort(Vec* v) {
+        const int size = RegisterCount * Lanes;
+        for (int block = 2; block <= size; block *= 2) {
+            if (block <= Lanes) {
+                for (int r = 0; r < RegisterCount; r++) {
+                    ExchangeLanes(v[r], block - 1);
+                }
+            } else {
+                const int registers = block / Lanes;
+                for (int r = 0; r < RegisterCount; r++) {
+                    if ((r & (registers / 2)) == 0) {
+                        Vec& high = v[r ^ (registers - 1)];
+                        Reverse(high);
+                        CompareExchange(v[r], high);
+                        Reverse(high);
+                    }
+                }
+            }
+
+            for (int stride = block / 4; stride >= 1; stride /= 2) {
+                if (stride >= Lanes) {
+                    const int registers = stride / Lanes;
+                    for (int r = 0; r < RegisterCount; r++) {
+                        if ((r & registers) == 0) {
+                            CompareExchange(v[r], v[r + registers]);
+                        }
+                    }
+                } else {
+                    for (int r = 0; r < RegisterCount; r++) {
+                        ExchangeLanes(v[r], stride);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    typedef NetworkLanes<Lanes> LaneShuffles;
+
+    __attribute__((always_inline)) static void CompareExchange(Vec& low, Vec& high) {
+        const Vec smaller = low < high ? low : high;
+        high = low < high ? high : low;
+        low = smaller;
+    }
+
+    __attribute__((always_inline)) static void Reverse(Vec& v) {
+        Vec reversed;
+        LaneShuffles::template Partner<Lanes - 1>(reversed, v);
+        v = reversed;
+    }
+
+    // Compares every lane i with lane i ^ Mask; the lane with Bit set keeps the larger item.
+    template <int Mask, int Bit>
+    __attribute__((always_inline)) static void ExchangeLanes(Vec& v) {
+        Vec partner;
+        LaneShuffles::template Partner<Mask>(partner, v);
+        const Vec low = v < partner ? v : partner;
+        const Vec high = v < partner ? partner : v;
+        LaneShuffles::template Blend<Bit>(v, low, high);
+    }
+
+    // The masks that come up with at most 8 lanes: strides 1, 2 and 4, and block reversals 3, 7.
+    __attribute__((always_inline)) static void ExchangeLanes(Vec& v, int mask) {
+        switch (mask) {
+        case 1: ExchangeLanes<1, 1>(v); break;
+        case 2: ExchangeLanes<2, 2>(v); break;
+        case 3: ExchangeLanes<3, 2>(v); break;
+        case 4: ExchangeLanes<4, 4>(v); break;
+        case 7: ExchangeLanes<7, 4>(v); break;
+        }
+    }
+};
+
+// Pads count items to RegisterCount vectors, sorts them and writes the first count back. Ranges
+// too long for RegisterCount vectors go on to twice as many, up to sorting_network_max_size items.
+template <typename T, typename Vec, int Lanes, int RegisterCount, bool Largest = (RegisterCount * Lanes >= static_cast<int>(sorting_network_max_size))>
+class NetworkSizes
+{
+public:
+    __attribute__((always_inline)) static void Sort(T* items, std::size_t count) {
+        if (count > static_cast<std::size_t>(RegisterCount * Lanes)) {
+            NetworkSizes<T, Vec, Lanes, RegisterCount * 2>::Sort(items, count);
+            return;
+        }
+        NetworkSizes<T, Vec, Lanes, RegisterCount, true>::Sort(items, count);
+    }
+};
+
+template <typename T, typename Vec, int Lanes, int RegisterCount>
+class NetworkSizes<T, Vec, Lanes, RegisterCount, true>
+{
+public:
+    __attribute__((always_inline)) static void Sort(T* items, std::size_t count) {
+        const T padding = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+        T padded[RegisterCount * Lanes];
+        std::copy(items, items + count, padded);
+        std::fill(padded + count, padded + RegisterCount * Lanes, padding);
+
+        Vec registers[RegisterCount];
+        std::memcpy(registers, padded, sizeof(padded));
+        BitonicNetwork<Vec, Lanes>::template Sort<RegisterCount>(registers);
+        std::memcpy(padded, registers, sizeof(padded));
+        std::copy(padded, padded + count, items);
+    }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+// Vectors of Bytes bytes of T, as the compiler's generic vector types, which become SSE or AVX
+// registers in functions compiled for those.
+template <typename T, int Bytes>
+class NetworkVector;
+
+template <>
+class NetworkVector<std::int32_t, 16> {
+public:
+    typedef std::int32_t Type __attribute__((vector_size(16)));
+};
+
+template <>
+class NetworkVector<std::int32_t, 32> {
+public:
+    typedef std::int32_t Type __attribute__((vector_size(32)));
+};
+
+template <>
+class NetworkVector<std::int64_t, 16> {
+public:
+    typedef std::int64_t Type __attribute__((vector_size(16)));
+};
+
+template <>
+class NetworkVector<std::int64_t, 32> {
+public:
+    typedef std::int64_t Type __attribute__((vector_size(32)));
+};
+
+template <>
+class NetworkVector<float, 16> {
+public:
+    typedef float Type __attribute__((vector_size(16)));
+};
+
+template <>
+class NetworkVector<float, 32> {
+public:
+    typedef float Type __attribute__((vector_size(32)));
+};
+#endif
+
+// Entry points for one item type, one per instruction set.
+template <typename T>
+class SortingNetwork
+{
+public:
+    static void SortScalar(T* items, std::size_t count) {
+        NetworkSizes<T, T, 1, 1>::Sort(items, count);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("sse4.2"))) static void SortSse4(T* items, std::size_t count) {
+        NetworkSizes<T, typename NetworkVector<T, 16>::Type, 16 / sizeof(T), 1>::Sort(items, count);
+    }
+
+    __attribute__((target("avx2"))) static void SortAvx2(T* items, std::size_t count) {
+        NetworkSizes<T, typename NetworkVector<T, 32>::Type, 32 / sizeof(T), 1>::Sort(items, count);
+    }
+#endif
+};
+
+// Whether this host can run isa.
+inline bool sorting_network_supports(SortingNetworkIsa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (isa) {
+    case SortingNetworkIsa::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case SortingNetworkIsa::Sse4:
+        return __builtin_cpu_supports("sse4.2");
+    case SortingNetworkIsa::Scalar:
+        return true;
+    }
+    return false;
+#else
+    return isa == SortingNetworkIsa::Scalar;
+#endif
+}
+
+// The best instruction set this host supports, checked once.
+inline SortingNetworkIsa sorting_network_isa() {
+    static const SortingNetworkIsa isa =
+        sorting_network_supports(SortingNetworkIsa::Avx2) ? SortingNetworkIsa::Avx2 :
+        sorting_network_supports(SortingNetworkIsa::Sse4) ? SortingNetworkIsa::Sse4 :
+        SortingNetworkIsa::Scalar;
+    return isa;
+}
+
+template <typename T>
+class is_sorting_network_type : public std::integral_constant<bool,
+    std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value || std::is_same<T, float>::value> {
+};
+
+// Sorts count items with isa, which the host must support. Returns false and leaves the items
+// alone when T is not int32, int64 or float, or there are more than sorting_network_max_size.
+template <typename T>
+typename std::enable_if<is_sorting_network_type<T>::value, bool>::type
+sorting_network_sort(T* items, std::size_t count, SortingNetworkIsa isa) {
+    if (count > sorting_network_max_size) {
+        return false;
+    }
+    if (count <= 1) {
+        return true;
+    }
+
+    switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SortingNetworkIsa::Avx2:
+        SortingNetwork<T>::SortAvx2(items, count);
+        break;
+    case SortingNetworkIsa::Sse4:
+        SortingNetwork<T>::SortSse4(items, count);
+        break;
+#endif
+    default:
+        SortingNetwork<T>::SortScalar(items, count);
+        break;
+    }
+    return true;
+}
+
+template <typename T>
+typename std::enable_if<!is_sorting_network_type<T>::value, bool>::type
+sorting_network_sort(T*, std::size_t, SortingNetworkIsa) {
+    return false;
+}
+
+// Sorts count items with the best instruction set of this host, if the network takes them.
+template <typename T>
+bool sorting_network_sort(T* items, std::size_t count) {
+    return sorting_network_sort(items, count, sorting_network_isa());
+}
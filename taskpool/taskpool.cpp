@@ -0,0 +1,87 @@
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include "taskpool.h"
+#include "gtest/gtest.h"
+
+long long parallel_sum(TaskPool& pool, const std::vector<int>& values, std::size_t begin, std::size_t end) {
+    if (end - begin <= 1000) {
+        return std::accumulate(values.begin() + begin, values.begin() + end, 0LL);
+    }
+
+    const std::size_t middle = begin + (end - begin) / 2;
+    long long left = 0;
+    long long right = 0;
+    pool.Invoke(
+        [&] { left = parallel_sum(pool, values, begin, middle); },
+        [&] { right = parallel_sum(pool, values, middle, end); }
+    );
+    return left + right;
+}
+
+TEST(TaskPool, NestedInvoke) {
+    std::vector<int> values(1000000);
+    std::iota(values.begin(), values.end(), 0);
+
+    for (int threads : { 1, 2, 4 }) {
+        TaskPool pool(threads);
+        EXPECT_EQ(threads, pool.GetThreadCount());
+        EXPECT_EQ(499999500000LL, parallel_sum(pool, values, 0, values.size()));
+    }
+}
+
+TEST(TaskPool, ParallelForCoversRange) {
+    TaskPool pool(4);
+    std::vector<std::atomic<int>> hits(10000);
+    for (auto& hit : hits) {
+        hit.store(0);
+    }
+
+    pool.ParallelFor(0, hits.size(), 64, [&] (std::size_t begin, std::size_t end) {
+        EXPECT_LE(end - begin, 64u);
+        for (std::size_t i = begin; i < end; i++) {
+            hits[i]++;
+        }
+    });
+
+    for (const auto& hit : hits) {
+        EXPECT_EQ(1, hit.load());
+    }
+}
+
+TEST(TaskPool, UsesSeveralThreads) {
+    TaskPool pool(4);
+    std::mutex mutex;
+    std::vector<std::thread::id> seen;
+
+    pool.ParallelFor(0, 64, 1, [&] (std::size_t, std::size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::find(seen.begin(), seen.end(), std::this_thread::get_id()) == seen.end()) {
+            seen.push_back(std::this_thread::get_id());
+        }
+    });
+
+    EXPECT_LT(1u, seen.size());
+}
+
+TEST(TaskPool, ExceptionsReachTheCaller) {
+    TaskPool pool(2);
+    EXPECT_THROW(
+        pool.Invoke([] {}, [] { throw std::runtime_error("right"); }),
+        std::runtime_error
+    );
+    EXPECT_THROW(
+        pool.Invoke([] { throw std::runtime_error("left"); }, [] {}),
+        std::runtime_error
+    );
+
+    // still usable afterwards
+    int calls = 0;
+    std::mutex mutex;
+    pool.Invoke(
+        [&] { std::lock_guard<std::mutex> lock(mutex); calls++; },
+        [&] { std::lock_guard<std::mutex> lock(mutex); calls++; }
+    );
+    EXPECT_EQ(2, calls);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join thread pool with work stealing. Every worker has its own deque of tasks: it pushes and
+// pops at the back, so it works depth first on what it spawned most recently, while idle workers
+// steal from the front, where the oldest and usually largest tasks are. Threads that wait for
+// their tasks run other tasks in the meantime, so nested Invoke() calls can't deadlock the pool.
+class TaskPool
+{
+public:
+    TaskPool(int thread_count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1)) :
+        m_thread_count(std::max(thread_count, 1)),
+        m_queued(0),
+        m_stopping(false) {
+        // one deque per worker plus one shared by threads from outside the pool
+        for (int i = 0; i <= m_thread_count; i++) {
+            m_queues.emplace_back(new Queue());
+        }
+
+        // the thread calling Invoke() counts as a worker, so start one fewer
+        for (int i = 1; i < m_thread_count; i++) {
+            m_threads.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    int GetThreadCount() const {
+        return m_thread_count;
+    }
+
+    // Runs left and right, in parallel if a worker is free, and returns when both have finished.
+    // An exception thrown by either is rethrown here.
+    void Invoke(const std::function<void ()>& left, const std::function<void ()>& right) {
+        Group group;
+        Push(Task { &right, &group });
+
+        try {
+            left();
+        } catch (...) {
+            group.Fail(std::current_exception());
+        }
+
+        Wait(group);
+        if (group.m_error) {
+            std::rethrow_exception(group.m_error);
+        }
+    }
+
+    // Calls body(begin, end) on pieces of [begin, end) no bigger than grain, splitting in halves
+    // with Invoke().
+    void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void (std::size_t, std::size_t)>& body) {
+        if (end - begin <= std::max<std::size_t>(grain, 1)) {
+            if (begin < end) {
+                body(begin, end);
+            }
+            return;
+        }
+
+        const std::size_t middle = begin + (end - begin) / 2;
+        Invoke(
+            [&] { ParallelFor(begin, middle, grain, body); },
+            [&] { ParallelFor(middle, end, grain, body); }
+        );
+    }
+
+private:
+
+    class Group {
+    public:
+        void Fail(std::exception_ptr error) {
+            std::lock_guard<std::mutex> lock(m_error_mutex);
+            if (!m_error) {
+                m_error = error;
+            }
+        }
+
+        std::atomic<int> m_pending { 1 };
+        std::mutex m_error_mutex;
+        std::exception_ptr m_error;
+    };
+
+    // The function is owned by the Invoke() call that pushed it, which outlives the task.
+    class Task {
+    public:
+        const std::function<void ()>* m_function;
+        Group* m_group;
+    };
+
+    class Queue {
+    public:
+        std::mutex m_mutex;
+        std::deque<Task> m_tasks;
+    };
+
+    // Which worker of which pool the current thread is; threads outside any pool use the shared
+    // queue.
+    class Identity {
+    public:
+        const TaskPool* m_pool = nullptr;
+        int m_index = 0;
+    };
+
+    static Identity& CurrentThread() {
+        static thread_local Identity identity;
+        return identity;
+    }
+
+    int QueueIndex() const {
+        const Identity& identity = CurrentThread();
+        return identity.m_pool == this ? identity.m_index : m_thread_count;
+    }
+
+    void Push(Task task) {
+        Queue& queue = *m_queues[QueueIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            queue.m_tasks.push_back(task);
+        }
+
+        m_queued.fetch_add(1);
+        {
+            // taking the lock orders this with a worker deciding to sleep
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        }
+        m_wake.notify_one();
+    }
+
+    // Takes a task from this thread's own queue first, then from everybody else's.
+    bool TryTake(Task& task) {
+        const int own = QueueIndex();
+        {
+            Queue& queue = *m_queues[own];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (!queue.m_tasks.empty()) {
+                task = queue.m_tasks.back();
+                queue.m_tasks.pop_back();
+                m_queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        const int queue_count = static_cast<int>(m_queues.size());
+        for (int offset = 1; offset < queue_count; offset++) {
+            Queue& queue = *m_queues[(own + offset) % queue_count];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (!queue.m_tasks.empty()) {
+                task = queue.m_tasks.front();
+                queue.m_tasks.pop_front();
+                m_queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static void Run(const Task& task) {
+        try {
+            (*task.m_function)();
+        } catch (...) {
+            task.m_group->Fail(std::current_exception());
+        }
+        task.m_group->m_pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Helps out with other tasks until every task of group has finished.
+    void Wait(Group& group) {
+        while (group.m_pending.load(std::memory_order_acquire) != 0) {
+            Task task;
+            if (TryTake(task)) {
+                Run(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void WorkerLoop(int index) {
+        CurrentThread().m_pool = this;
+        CurrentThread().m_index = index;
+
+        while (true) {
+            Task task;
+            if (TryTake(task)) {
+                Run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+            if (m_stopping) {
+                return;
+            }
+        }
+    }
+
+    int m_thread_count;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<int> m_queued;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
+
+// Pool shared by the parallel algorithms in this repository, with one thread per core.
+inline TaskPool& default_task_pool() {
+    static TaskPool pool;
+    return pool;
+}